@@ -0,0 +1,15 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+//The benchmarks always count their allocations, with the replacement of the
+//global allocation functions of the telemetry
+
+#ifndef ANA_COUNT_ALLOCATIONS
+#define ANA_COUNT_ALLOCATIONS
+#endif
+
+#include "../../src/allocations.cpp"
@@ -0,0 +1,1182 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+//The benchmarks of the data pipeline, on a synthetic corpus:
+//
+//    ana_bench [directory] [files] [frames] [--option=value...]
+//
+//  --repeat=N         Run each benchmark N times and keep the best time (default 3)
+//  --filter=text      Only run the benchmarks whose name contains text
+//  --listing=N        The number of files of the synthetic listing of pair_files (default 500000)
+//  --save=file        Save the results as a baseline
+//  --baseline=file    Compare the results with a saved baseline and fail on regressions
+//  --tolerance=x      The relative slowdown tolerated by the comparison (default 0.1)
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <string>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+
+#include <sys/stat.h>
+
+#include "config.hpp"
+#include "frames.hpp"
+#include "features_writer.hpp"
+#include "window_arena.hpp"
+#include "data.hpp"
+#include "io.hpp"
+#include "normalization.hpp"
+#include "vocabulary.hpp"
+#include "sample_iterator.hpp"
+#include "label_iterator.hpp"
+#include "prefetch_iterator.hpp"
+#include "paired_iterator.hpp"
+#include "blas.hpp"
+#include "sgd.hpp"
+#include "cd.hpp"
+#include "memory_cache.hpp"
+#include "telemetry.hpp"
+
+namespace {
+
+using clock_type = std::chrono::high_resolution_clock;
+
+//Must be incremented each time the layout of the baseline changes
+constexpr const std::size_t baseline_version = 1;
+
+/*!
+ * \brief The result of one benchmark
+ */
+struct bench_result {
+    std::string name;
+    double rate;                 ///< The number of items per second of the best run
+    std::size_t allocations;     ///< The number of allocations of one run
+};
+
+/*!
+ * \brief Run the benchmarks and compare them with a baseline
+ */
+struct bench_suite {
+    std::size_t repeat = 3;
+    std::string filter;
+
+    std::vector<bench_result> results;
+
+    bool enabled(const std::string& name) const {
+        return name.find(filter) != std::string::npos;
+    }
+
+    /*!
+     * \brief Run functor repeat times and report the best time. functor returns
+     * the number of items processed, bytes is the number of bytes processed by
+     * each run (0 if not relevant).
+     */
+    template<typename Functor>
+    void run(const std::string& name, const std::string& unit, std::size_t bytes, Functor functor){
+        run(name, unit, bytes, repeat, functor);
+    }
+
+    template<typename Functor>
+    void run(const std::string& name, const std::string& unit, std::size_t bytes, std::size_t repeat, Functor functor){
+        if(!enabled(name)){
+            return;
+        }
+
+        double best = 0.0;
+        std::size_t items = 0;
+        std::size_t run_allocations = 0;
+
+        for(std::size_t r = 0; r < repeat; ++r){
+            auto before = ana::allocations();
+            auto start = clock_type::now();
+
+            items = functor();
+
+            auto end = clock_type::now();
+            auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
+
+            if(!r || seconds < best){
+                best = seconds;
+                run_allocations = ana::allocations() - before;
+            }
+        }
+
+        best = std::max(best, 1e-9);
+
+        std::cout << std::left << std::setw(36) << name << std::right
+            << std::setw(12) << items << " " << unit << " in " << std::fixed << std::setprecision(1) << std::setw(9) << best * 1000.0 << "ms ("
+            << std::setprecision(0) << items / best << " " << unit << "/s";
+
+        if(bytes){
+            std::cout << ", " << std::setprecision(1) << (bytes / (1024.0 * 1024.0)) / best << " MB/s";
+        }
+
+        std::cout << ") " << run_allocations << " allocations" << std::defaultfloat << std::endl;
+
+        results.push_back({name, items / best, run_allocations});
+    }
+
+    bool save(const std::string& file) const {
+        std::ofstream stream(file);
+
+        stream << "ana-bench " << baseline_version << "\n";
+
+        for(auto& result : results){
+            stream << std::setprecision(9) << result.rate << " " << result.allocations << " " << result.name << "\n";
+        }
+
+        return static_cast<bool>(stream);
+    }
+
+    /*!
+     * \brief Compare the results with the given baseline
+     * \return false if a benchmark is slower than the baseline by more than tolerance
+     */
+    bool compare(const std::string& file, double tolerance) const {
+        std::ifstream stream(file);
+
+        std::string line;
+        if(!std::getline(stream, line) || line != "ana-bench " + std::to_string(baseline_version)){
+            std::cout << "Invalid baseline file \"" << file << "\"" << std::endl;
+            return false;
+        }
+
+        std::map<std::string, bench_result> baseline;
+
+        bench_result result;
+        while(stream >> result.rate >> result.allocations && stream.get() == ' ' && std::getline(stream, result.name)){
+            baseline[result.name] = result;
+        }
+
+        std::cout << "\nComparison with " << file << std::endl;
+
+        bool valid = true;
+
+        for(auto& current : results){
+            auto it = baseline.find(current.name);
+
+            if(it == baseline.end()){
+                continue;
+            }
+
+            auto ratio = current.rate / it->second.rate;
+            bool regression = ratio < 1.0 - tolerance;
+
+            std::cout << std::left << std::setw(36) << current.name << std::right << std::fixed << std::setprecision(2)
+                << std::setw(8) << ratio << "x speed, " << std::defaultfloat
+                << it->second.allocations << " -> " << current.allocations << " allocations"
+                << (regression ? "  REGRESSION" : "") << std::endl;
+
+            valid = valid && !regression;
+        }
+
+        return valid;
+    }
+};
+
+//The parser used by read_samples before the frames parser
+std::size_t legacy_read(const std::string& file){
+    std::vector<std::vector<float>> raw_samples;
+
+    std::ifstream infile(file);
+
+    std::string line;
+    while (std::getline(infile, line)){
+        std::vector<float> sample;
+
+        std::istringstream iss(line);
+        float feature;
+
+        while(iss >> feature){
+            sample.push_back(feature);
+        }
+
+        raw_samples.push_back(std::move(sample));
+    }
+
+    return raw_samples.size();
+}
+
+std::size_t fast_read(const std::string& file){
+    ana::frames_t frames;
+    ana::read_frames(file, frames);
+    return frames.rows;
+}
+
+/*!
+ * \brief Write a file of decimal values close to the midpoints between two
+ * floats, the hard cases of the rounding, and return the number of values
+ * read_frames does not parse like strtof.
+ */
+std::size_t rounding_differences(const std::string& directory, std::size_t values){
+    std::mt19937_64 generator(42);
+
+    std::vector<std::string> tokens;
+
+    for(std::size_t i = 0; i < values; ++i){
+        auto f = std::ldexp(float(generator() % (1 << 23)) / (1 << 23) + 1.0f, int(generator() % 40) - 20);
+        auto midpoint = (double(f) + double(std::nextafter(f, 2.0f * f))) / 2.0;
+
+        char token[64];
+        std::snprintf(token, sizeof(token), "%.*g", int(8 + generator() % 8), (generator() & 1) ? -midpoint : midpoint);
+        tokens.push_back(token);
+    }
+
+    auto file = directory + "/rounding.feat";
+
+    auto fp = std::fopen(file.c_str(), "w");
+    for(std::size_t i = 0; i < values; ++i){
+        std::fprintf(fp, (i + 1) % Features ? "%s " : "%s\n", tokens[i].c_str());
+    }
+    std::fclose(fp);
+
+    ana::frames_t frames;
+    ana::read_frames(file, frames);
+
+    std::size_t differences = 0;
+
+    for(std::size_t i = 0; i < values; ++i){
+        auto expected = std::strtof(tokens[i].c_str(), nullptr);
+
+        if(std::memcmp(&expected, &frames.values[i], sizeof(float))){
+            ++differences;
+        }
+    }
+
+    return differences;
+}
+
+//The labels of the synthetic corpus, 41 phones and the silence
+std::string phone(std::size_t i){
+    return i % 42 == 41 ? "sil" : "p" + std::to_string(i % 42);
+}
+
+/*!
+ * \brief Generate files .feat files of frames frames in directory/feat and
+ * their .framelab files in directory/lab. The labels are in runs of a few
+ * frames, like the phones of an utterance.
+ */
+std::pair<ana::files_t, ana::files_t> generate_corpus(const std::string& directory, std::size_t files, std::size_t frames){
+    mkdir(directory.c_str(), S_IRWXU);
+    mkdir((directory + "/feat").c_str(), S_IRWXU);
+    mkdir((directory + "/lab").c_str(), S_IRWXU);
+
+    std::mt19937 generator(42);
+    std::normal_distribution<float> distribution(0.0, 10.0);
+    std::uniform_int_distribution<std::size_t> phones(0, 41);
+    std::uniform_int_distribution<std::size_t> durations(3, 15);
+
+    ana::files_t samples_files;
+    ana::files_t labels_files;
+
+    for(std::size_t f = 0; f < files; ++f){
+        samples_files.push_back(directory + "/feat/" + std::to_string(f) + ".feat");
+        labels_files.push_back(directory + "/lab/" + std::to_string(f) + ".framelab");
+
+        auto fp = std::fopen(samples_files.back().c_str(), "w");
+
+        for(std::size_t i = 0; i < frames; ++i){
+            for(std::size_t j = 0; j < Features; ++j){
+                std::fprintf(fp, j ? " %f" : "%f", distribution(generator));
+            }
+            std::fputc('\n', fp);
+        }
+
+        std::fclose(fp);
+
+        fp = std::fopen(labels_files.back().c_str(), "w");
+
+        for(std::size_t i = 0; i < frames;){
+            auto label = phone(phones(generator));
+
+            for(std::size_t d = durations(generator); d && i < frames; --d, ++i){
+                std::fprintf(fp, "%s\n", label.c_str());
+            }
+        }
+
+        std::fclose(fp);
+    }
+
+    //The list files of the corpus
+    std::ofstream(directory + "/samples.txt") << directory << "/feat\n";
+    std::ofstream(directory + "/labels.txt") << directory << "/lab\n";
+
+    return {samples_files, labels_files};
+}
+
+std::size_t corpus_bytes(const std::vector<std::string>& files){
+    std::size_t bytes = 0;
+
+    for(auto& file : files){
+        struct stat buffer;
+        if(stat(file.c_str(), &buffer) == 0){
+            bytes += buffer.st_size;
+        }
+    }
+
+    return bytes;
+}
+
+//The window assembly used by read_samples before the window arena
+std::size_t legacy_windows(const ana::frames_t& frames){
+    std::vector<ana::sample_t> samples;
+
+    for(std::size_t i = 0; i + N < frames.rows; i += Stride){
+        ana::sample_t sample(Features * N);
+
+        std::copy(frames.row(i), frames.row(i + N), sample.begin());
+
+        samples.push_back(std::move(sample));
+    }
+
+    return samples.size();
+}
+
+//Count the windows of an iterator range, touching each of them
+template<typename Iterator>
+std::size_t traverse(Iterator it, Iterator end){
+    std::size_t windows = 0;
+    float sum = 0.0f;
+
+    for(; it != end; ++it){
+        sum += (*it)[0];
+        ++windows;
+    }
+
+    //Use the sum so that the traversal is not optimized away
+    return windows + (sum == 42.0f);
+}
+
+template<typename Iterator>
+std::size_t traverse_labels(Iterator it, Iterator end){
+    std::size_t labels = 0;
+    std::size_t sum = 0;
+
+    for(; it != end; ++it){
+        sum += *it;
+        ++labels;
+    }
+
+    return labels + (sum == 42);
+}
+
+/*!
+ * \brief The batched forward pass of a DBN like the one of main.cpp, with
+ * random weights: window_size -> 500 -> 200 -> 42, the label being the
+ * largest output.
+ */
+struct forward_model {
+    std::vector<std::size_t> sizes;
+    std::vector<std::vector<float>> weights;
+    std::vector<std::vector<float>> biases;
+    std::vector<std::vector<float>> activations;
+    std::vector<std::size_t> predictions;   ///< The label of each window of the last batch
+
+    explicit forward_model(std::size_t input) : sizes{input, 500, 200, 42} {
+        std::mt19937 generator(42);
+        std::normal_distribution<float> distribution(0.0, 0.01);
+
+        for(std::size_t l = 0; l + 1 < sizes.size(); ++l){
+            weights.emplace_back(sizes[l] * sizes[l + 1]);
+            biases.emplace_back(sizes[l + 1]);
+
+            for(auto& weight : weights.back()){
+                weight = distribution(generator);
+            }
+        }
+
+        activations.resize(weights.size());
+    }
+
+    //Return the sum of the labels of the rows windows of input
+    std::size_t predict(const float* input, std::size_t rows){
+        for(std::size_t l = 0; l < weights.size(); ++l){
+            auto hidden = sizes[l + 1];
+            auto& output = activations[l];
+
+            output.resize(rows * hidden);
+
+            for(std::size_t r = 0; r < rows; ++r){
+                std::copy(biases[l].begin(), biases[l].end(), output.begin() + r * hidden);
+            }
+
+            //Like the batch forward pass of ana::test
+            if(exact_inference){
+                ana::ordered_gemm(false, false, rows, hidden, sizes[l], 1.0f, input, sizes[l], weights[l].data(), hidden, 1.0f, output.data(), hidden);
+            } else {
+                ana::gemm(false, false, rows, hidden, sizes[l], 1.0f, input, sizes[l], weights[l].data(), hidden, 1.0f, output.data(), hidden);
+            }
+
+            if(l + 2 < sizes.size()){
+                for(auto& value : output){
+                    value = 1.0f / (1.0f + std::exp(-value));
+                }
+            }
+
+            input = output.data();
+        }
+
+        std::size_t labels = 0;
+
+        predictions.resize(rows);
+
+        for(std::size_t r = 0; r < rows; ++r){
+            auto row = input + r * sizes.back();
+            predictions[r] = std::max_element(row, row + sizes.back()) - row;
+            labels += predictions[r];
+        }
+
+        return labels;
+    }
+
+    //Return the label of one window, the product being done per window as by dbn.predict
+    std::size_t predict_window(const float* input){
+        std::vector<float> values(input, input + sizes[0]);
+        std::vector<float> output;
+
+        for(std::size_t l = 0; l < weights.size(); ++l){
+            auto hidden = sizes[l + 1];
+
+            output.assign(biases[l].begin(), biases[l].end());
+
+            for(std::size_t j = 0; j < hidden; ++j){
+                for(std::size_t i = 0; i < sizes[l]; ++i){
+                    output[j] += values[i] * weights[l][i * hidden + j];
+                }
+            }
+
+            if(l + 2 < sizes.size()){
+                for(auto& value : output){
+                    value = 1.0f / (1.0f + std::exp(-value));
+                }
+            }
+
+            values.swap(output);
+        }
+
+        return std::max_element(values.begin(), values.end()) - values.begin();
+    }
+};
+
+std::string legacy_remove_extension(const std::string& file, const std::vector<std::string>& extensions){
+    for(auto& extension : extensions){
+        auto extension_length = extension.size();
+
+        if(file.size() <= extension_length){
+            continue;
+        }
+
+        if(std::string(file.begin() + file.size() - extension_length, file.end()) == extension){
+            return std::string(file.begin(), file.begin() + file.size() - extension_length);
+        }
+    }
+
+    return file;
+}
+
+//The pairing used by get_paired_files before the hashed index
+ana::paired_files_t legacy_pair_files(const ana::files_t& ft_samples_files, const ana::files_t& ft_labels_files){
+    std::vector<std::string> feature_extension{"feat"};
+    std::vector<std::string> label_extension{"framelab", "3phnlab"};
+
+    ana::files_t samples_files;
+    ana::files_t labels_files;
+
+    for(auto& s_file : ft_samples_files){
+        bool found = false;
+
+        for(auto& l_file : ft_labels_files){
+            auto clean_s = legacy_remove_extension(s_file, feature_extension);
+            auto clean_l = legacy_remove_extension(l_file, label_extension);
+
+            if(clean_l == clean_s){
+                samples_files.push_back(s_file);
+                labels_files.push_back(l_file);
+
+                found = true;
+                break;
+            }
+
+            if(std::count(clean_s.begin(), clean_s.end(), '/') > 1 && std::count(clean_l.begin(), clean_l.end(), '/') > 1){
+                auto last_s = clean_s.find_last_of('/');
+                auto last_l = clean_l.find_last_of('/');
+
+                auto prelast_s = clean_s.find_last_of('/', last_s - 1);
+                auto prelast_l = clean_l.find_last_of('/', last_l - 1);
+
+                auto clean_clean_s =
+                    std::string(clean_s.begin(), clean_s.begin() + prelast_s + 1)
+                    +   std::string(clean_s.begin() + last_s, clean_s.end());
+
+                auto clean_clean_l =
+                    std::string(clean_l.begin(), clean_l.begin() + prelast_l + 1)
+                    +   std::string(clean_l.begin() + last_l, clean_l.end());
+
+                if(clean_clean_l == clean_clean_s){
+                    samples_files.push_back(s_file);
+                    labels_files.push_back(l_file);
+
+                    found = true;
+                    break;
+                }
+            }
+        }
+
+        if(!found){
+            std::cout << "No equivalent found for " << s_file << std::endl;
+        }
+    }
+
+    return {samples_files, labels_files};
+}
+
+//A synthetic listing: half of the labels are next to their samples, half in a sibling directory
+std::pair<ana::files_t, ana::files_t> generate_listing(std::size_t files){
+    ana::files_t samples_files;
+    ana::files_t labels_files;
+
+    for(std::size_t i = 0; i < files; ++i){
+        auto utterance = "/corpus/dr" + std::to_string(i % 8) + "/spk" + std::to_string(i / 10) + "/";
+        auto name = "utt" + std::to_string(i);
+
+        samples_files.push_back(utterance + "feat/" + name + ".feat");
+
+        //A few samples files do not have labels
+        if(i % 100000 == 99999){
+            continue;
+        }
+
+        if(i % 2){
+            labels_files.push_back(utterance + "feat/" + name + ".framelab");
+        } else {
+            labels_files.push_back(utterance + "lab/" + name + ".3phnlab");
+        }
+    }
+
+    std::mt19937 generator(42);
+    std::shuffle(labels_files.begin(), labels_files.end(), generator);
+
+    return {samples_files, labels_files};
+}
+
+//The formatting used by generate_features before the features writers
+std::size_t legacy_write(const std::vector<float>& features, std::size_t dims){
+    std::ostringstream out;
+
+    for(std::size_t i = 0; i < features.size(); ++i){
+        out << features[i] << ",";
+
+        if((i + 1) % dims == 0){
+            out << '\n';
+        }
+    }
+
+    return out.str().size();
+}
+
+template<typename Writer>
+std::size_t writer_write(const Writer& writer, const std::vector<float>& features, std::size_t dims){
+    std::string out;
+
+    writer.begin(out);
+    writer.write(out, features.data(), features.size() / dims, dims);
+    writer.end(out, 0, dims, features.size() / dims);
+
+    return out.size();
+}
+
+} //end of anonymous namespace
+
+int main(int argc, char* argv[]){
+    std::vector<std::string> positional;
+
+    bench_suite suite;
+
+    std::size_t listing_files = 500000;
+    std::string save_file;
+    std::string baseline_file;
+    double tolerance = 0.1;
+
+    for(int i = 1; i < argc; ++i){
+        std::string arg(argv[i]);
+
+        auto value = arg.substr(arg.find('=') + 1);
+
+        if(arg.compare(0, 9, "--repeat=") == 0){
+            suite.repeat = std::max(std::stoul(value), 1ul);
+        } else if(arg.compare(0, 9, "--filter=") == 0){
+            suite.filter = value;
+        } else if(arg.compare(0, 10, "--listing=") == 0){
+            listing_files = std::stoul(value);
+        } else if(arg.compare(0, 7, "--save=") == 0){
+            save_file = value;
+        } else if(arg.compare(0, 11, "--baseline=") == 0){
+            baseline_file = value;
+        } else if(arg.compare(0, 12, "--tolerance=") == 0){
+            tolerance = std::stod(value);
+        } else if(arg.compare(0, 2, "--") == 0){
+            std::cout << "Invalid option :" << arg << std::endl;
+            return 2;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    std::string directory = positional.size() > 0 ? positional[0] : "/tmp/ana_bench";
+    std::size_t files = positional.size() > 1 ? std::stoul(positional[1]) : 100;
+    std::size_t frames = positional.size() > 2 ? std::stoul(positional[2]) : 5000;
+
+    std::cout << "Generate " << files << " files of " << frames << " frames in " << directory << std::endl;
+
+    auto corpus = generate_corpus(directory, files, frames);
+    auto& names = corpus.first;
+    auto& label_names = corpus.second;
+
+    auto bytes = corpus_bytes(names);
+    auto label_bytes = corpus_bytes(label_names);
+
+    //1. Parsing of the samples files
+
+    suite.run("parse/getline", "frames", bytes, [&]{
+        std::size_t rows = 0;
+        for(auto& name : names){
+            rows += legacy_read(name);
+        }
+        return rows;
+    });
+
+    suite.run("parse/read_frames", "frames", bytes, [&]{
+        std::size_t rows = 0;
+        for(auto& name : names){
+            rows += fast_read(name);
+        }
+        return rows;
+    });
+
+    if(suite.enabled("parse/read_frames")){
+        auto differences = rounding_differences(directory, 1000 * Features);
+
+        std::cout << "   " << differences << " of " << 1000 * Features << " values near a rounding midpoint differ from strtof" << std::endl;
+
+        if(differences){
+            std::cout << "error: read_frames does not round like strtof" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<ana::frames_t> file_frames(names.size());
+    for(std::size_t i = 0; i < names.size(); ++i){
+        ana::read_frames(names[i], file_frames[i]);
+    }
+
+    //2. Normalization and windows
+
+    suite.run("normalize", "frames", 0, [&]{
+        std::size_t rows = 0;
+        for(std::size_t i = 0; i < names.size(); ++i){
+            ana::normalize_frames(names[i], file_frames[i]);
+            rows += file_frames[i].rows;
+        }
+        return rows;
+    });
+
+    suite.run("windows/vector", "windows", 0, [&]{
+        std::size_t windows = 0;
+        for(auto& f : file_frames){
+            windows += legacy_windows(f);
+        }
+        return windows;
+    });
+
+    ana::window_arena arena;
+
+    suite.run("windows/arena", "windows", 0, [&]{
+        std::size_t windows = 0;
+        for(auto& f : file_frames){
+            ana::assemble_windows(f, arena);
+            windows += arena.windows();
+        }
+        return windows;
+    });
+
+    //3. Labels
+
+    ana::vocabulary().build(label_names, load_threads);
+    ana::vocabulary().freeze();
+
+    suite.run("read_labels", "windows", label_bytes, [&]{
+        std::vector<std::size_t> labels;
+        for(auto& name : label_names){
+            ana::read_labels(name, labels);
+        }
+        return labels.size();
+    });
+
+    //4. Pairing of the samples and labels files
+
+    //The lists are resolved once by get_files, the following calls are not measured
+    ana::paired_files_t paired_files;
+
+    suite.run("get_paired_files", "files", 0, 1, [&]{
+        paired_files = ana::get_paired_files(directory + "/samples.txt", directory + "/labels.txt");
+        return paired_files.first.size();
+    });
+
+    if(!suite.enabled("get_paired_files")){
+        paired_files = ana::get_paired_files(directory + "/samples.txt", directory + "/labels.txt");
+    }
+
+    auto small_listing = generate_listing(5000);
+
+    ana::paired_files_t legacy_pairs;
+    ana::paired_files_t hashed_pairs;
+
+    suite.run("pair_files/nested (5000)", "files", 0, 1, [&]{
+        legacy_pairs = legacy_pair_files(small_listing.first, small_listing.second);
+        return small_listing.first.size();
+    });
+
+    suite.run("pair_files/hashed (5000)", "files", 0, [&]{
+        hashed_pairs = ana::pair_files(small_listing.first, small_listing.second);
+        return small_listing.first.size();
+    });
+
+    if(suite.enabled("pair_files/nested") && suite.enabled("pair_files/hashed") && legacy_pairs != hashed_pairs){
+        std::cout << "error: the pairings are different" << std::endl;
+        return 1;
+    }
+
+    if(suite.enabled("pair_files/hashed")){
+        auto listing = generate_listing(listing_files);
+
+        suite.run("pair_files/hashed (" + std::to_string(listing_files) + ")", "files", 0, [&]{
+            return ana::pair_files(listing.first, listing.second).first.size();
+        });
+    }
+
+    //5. Traversal of the windows by the iterators of the training
+
+    suite.run("traverse/eager", "windows", bytes + label_bytes, [&]{
+        std::vector<ana::sample_t> pt_samples;
+        std::vector<ana::sample_t> ft_samples;
+        std::vector<std::size_t> ft_labels;
+
+        ana::read_data(directory + "/samples.txt", paired_files, pt_samples, ft_samples, ft_labels, false, false);
+
+        return traverse(pt_samples.begin(), pt_samples.end()) + traverse(ft_samples.begin(), ft_samples.end())
+            + traverse_labels(ft_labels.begin(), ft_labels.end());
+    });
+
+    suite.run("traverse/sample_iterator", "windows", bytes, [&]{
+        ana::sample_iterator it(paired_files, names, true);
+        ana::sample_iterator end(paired_files, names, true, names.size());
+
+        return traverse(it, end);
+    });
+
+    suite.run("traverse/label_iterator", "windows", label_bytes, [&]{
+        ana::label_iterator it(paired_files);
+        ana::label_iterator end(paired_files, paired_files.second.size());
+
+        return traverse_labels(it, end);
+    });
+
+    suite.run("traverse/prefetch_sample_iterator", "windows", bytes, [&]{
+        ana::prefetch_sample_iterator it(paired_files, names, true);
+        ana::prefetch_sample_iterator end(paired_files, names, true, names.size());
+
+        return traverse(it, end);
+    });
+
+    suite.run("traverse/paired_iterators", "windows", bytes + label_bytes, [&]{
+        auto source = std::make_shared<ana::paired_source>(paired_files);
+
+        ana::paired_sample_iterator it(source);
+        ana::paired_sample_iterator end(source, paired_files.first.size());
+
+        ana::paired_label_iterator lit(source);
+        ana::paired_label_iterator lend(source, paired_files.first.size());
+
+        return traverse(it, end) + traverse_labels(lit, lend);
+    });
+
+    //The paired source must still prefetch after the first epoch, the files are repeated so that the
+    //second epoch is not served by the history of the source
+
+    ana::paired_files_t repeated_files;
+
+    for(std::size_t r = 0; r < 3; ++r){
+        repeated_files.first.insert(repeated_files.first.end(), paired_files.first.begin(), paired_files.first.end());
+        repeated_files.second.insert(repeated_files.second.end(), paired_files.second.begin(), paired_files.second.end());
+    }
+
+    std::size_t prefetched_files = 0;
+
+    suite.run("traverse/paired_iterators (2 epochs)", "windows", 6 * (bytes + label_bytes), [&]{
+        auto source = std::make_shared<ana::paired_source>(repeated_files);
+
+        ana::paired_sample_iterator it(source);
+        ana::paired_sample_iterator end(source, repeated_files.first.size());
+
+        ana::paired_label_iterator lit(source);
+        ana::paired_label_iterator lend(source, repeated_files.first.size());
+
+        auto windows = traverse(it, end) + traverse_labels(lit, lend);
+
+        ana::prefetch_stats().reset();
+
+        windows += traverse(it, end) + traverse_labels(lit, lend);
+
+        prefetched_files = ana::prefetch_stats().files;
+
+        return windows;
+    });
+
+    if(prefetch && suite.enabled("traverse/paired_iterators (2 epochs)") && prefetched_files == 0){
+        std::cout << "error: the paired source does not prefetch after the first epoch" << std::endl;
+        return 1;
+    }
+
+    //The memory cache of the lazy iterators, holding 60% of the windows, over three epochs
+
+    std::size_t windows_bytes = 0;
+
+    for(auto& name : names){
+        ana::read_windows(paired_files, name, arena, true);
+        windows_bytes += arena.windows() * arena.window_size() * sizeof(float);
+    }
+
+    double cache_hits = 0.0;
+
+    suite.run("traverse/memory_cache (60%, 3 epochs)", "windows", 0, [&]{
+        ana::memory_cache_t cache(windows_bytes * 6 / 10);
+
+        std::size_t windows = 0;
+
+        for(std::size_t epoch = 0; epoch < 3; ++epoch){
+            for(auto& name : names){
+                std::size_t frames;
+
+                if(!cache.load(name, false, arena, frames)){
+                    frames = ana::read_windows(paired_files, name, arena, true);
+                    cache.store(name, false, arena, frames);
+                }
+
+                windows += arena.windows();
+            }
+        }
+
+        cache_hits = cache.hits / double(cache.hits + cache.misses);
+
+        return windows;
+    });
+
+    if(cache_hits > 0.0){
+        std::cout << "   memory cache: " << std::fixed << std::setprecision(1) << 100.0 * cache_hits << "% of hits" << std::endl;
+    }
+
+    //The same cache on the paired path of the fine-tuning, which also keeps the labels of the files, over three epochs
+
+    std::size_t labels_bytes = 0;
+
+    for(auto& name : label_names){
+        std::vector<std::size_t> labels;
+        ana::read_labels(name, labels);
+        labels_bytes += labels.size() * sizeof(std::size_t);
+    }
+
+    cache_hits = 0.0;
+
+    suite.run("traverse/memory_cache+labels (60%)", "windows", 0, [&]{
+        ana::memory_cache_t cache((windows_bytes + labels_bytes) * 6 / 10);
+
+        std::size_t windows = 0;
+
+        std::vector<std::size_t> labels;
+
+        for(std::size_t epoch = 0; epoch < 3; ++epoch){
+            for(std::size_t i = 0; i < names.size(); ++i){
+                std::size_t frames;
+
+                labels.clear();
+
+                if(!cache.load(label_names[i], labels)){
+                    ana::read_labels(label_names[i], labels);
+                    cache.store(label_names[i], labels);
+                }
+
+                if(!cache.load(names[i], false, arena, frames)){
+                    frames = ana::read_windows(paired_files, names[i], arena, true);
+                    cache.store(names[i], false, arena, frames);
+                }
+
+                windows += arena.windows();
+            }
+        }
+
+        cache_hits = cache.hits / double(cache.hits + cache.misses);
+
+        return windows;
+    });
+
+    if(cache_hits > 0.0){
+        std::cout << "   memory cache: " << std::fixed << std::setprecision(1) << 100.0 * cache_hits << "% of hits" << std::endl;
+    }
+
+    //6. Batched prediction of the windows
+
+    //The benchmarks of the windows may have been filtered out
+    ana::assemble_windows(file_frames.front(), arena);
+
+    forward_model model(arena.window_size());
+
+    suite.run("predict", "windows", 0, [&]{
+        std::size_t windows = 0;
+        std::size_t labels = 0;
+
+        for(auto& f : file_frames){
+            ana::assemble_windows(f, arena);
+
+            for(std::size_t i = 0; i < arena.windows(); i += inference_batch){
+                auto rows = std::min(inference_batch, arena.windows() - i);
+
+                labels += model.predict(arena.window(i), rows);
+                windows += rows;
+            }
+        }
+
+        return windows + (labels == 42);
+    });
+
+    //The predictions of the batches are compared to the per-window products on all the windows
+
+    std::size_t different_predictions = 0;
+
+    suite.run("predict/per-window check", "windows", 0, [&]{
+        std::size_t windows = 0;
+
+        different_predictions = 0;
+
+        for(auto& f : file_frames){
+            ana::assemble_windows(f, arena);
+
+            for(std::size_t i = 0; i < arena.windows(); i += inference_batch){
+                auto rows = std::min(inference_batch, arena.windows() - i);
+
+                model.predict(arena.window(i), rows);
+
+                for(std::size_t r = 0; r < rows; ++r){
+                    different_predictions += model.predict_window(arena.window(i + r)) != model.predictions[r];
+                }
+
+                windows += rows;
+            }
+        }
+
+        return windows;
+    });
+
+    if(suite.enabled("predict/per-window check")){
+        std::cout << "   batched predictions: " << different_predictions << " windows predicted differently" << std::endl;
+
+        if(exact_inference && different_predictions){
+            std::cout << "error: the batched predictions are not the per-window predictions" << std::endl;
+            return 1;
+        }
+    }
+
+    //7. Parallel SGD fine-tuning of the same network, on 1, 2, 4, 8 and all the cores
+
+    std::vector<ana::sgd_layer> sgd_layers;
+
+    for(std::size_t l = 0; l < model.weights.size(); ++l){
+        auto unit = l + 1 < model.weights.size() ? dll::unit_type::BINARY : dll::unit_type::SOFTMAX;
+        sgd_layers.push_back({model.weights[l].data(), model.biases[l].data(), model.sizes[l], model.sizes[l + 1], unit});
+    }
+
+    std::vector<ana::sgd_batch> sgd_batches;
+    std::size_t sgd_windows = 0;
+
+    {
+        std::mt19937 label_generator(42);
+        std::uniform_int_distribution<std::size_t> label_distribution(0, model.sizes.back() - 1);
+
+        ana::assemble_windows(file_frames.front(), arena);
+
+        for(std::size_t i = 0; i < arena.windows(); i += sgd_batch_size){
+            auto rows = std::min(sgd_batch_size, arena.windows() - i);
+
+            ana::sgd_batch batch;
+            batch.inputs.assign(arena.window(i), arena.window(i) + rows * arena.window_size());
+
+            for(std::size_t r = 0; r < rows; ++r){
+                batch.labels.push_back(label_distribution(label_generator));
+            }
+
+            sgd_windows += rows;
+            sgd_batches.push_back(std::move(batch));
+        }
+    }
+
+    ana::sgd_parameters sgd_parameters{0.1f, 0.9f, 0.0002f};
+
+    auto sgd_epoch = [&](std::size_t threads, bool hogwild){
+        ana::sgd_trainer trainer(sgd_layers, threads);
+
+        ana::bounded_queue<ana::sgd_batch> batches(sgd_batches.size());
+
+        for(auto& batch : sgd_batches){
+            batches.push(batch);
+        }
+
+        batches.close();
+
+        return sgd_windows + (trainer.epoch(batches, sgd_parameters, hogwild) == 42);
+    };
+
+    auto cores = ana::threads_count(0);
+
+    std::vector<std::size_t> thread_counts;
+
+    for(std::size_t threads : {1, 2, 4, 8}){
+        if(threads < cores){
+            thread_counts.push_back(threads);
+        }
+    }
+
+    thread_counts.push_back(cores);
+
+    for(auto threads : thread_counts){
+        suite.run("sgd/threads=" + std::to_string(threads), "windows", 0, [&]{ return sgd_epoch(threads, false); });
+    }
+
+    suite.run("sgd/hogwild", "windows", 0, [&]{ return sgd_epoch(cores, true); });
+
+    //The synchronous SGD must give the same weights on 1 and 4 threads after 5 epochs, up to the order of the sums
+
+    if(suite.enabled("sgd/threads")){
+        auto train = [&](std::size_t threads){
+            auto weights = model.weights;
+            auto biases = model.biases;
+
+            auto layers = sgd_layers;
+
+            for(std::size_t l = 0; l < layers.size(); ++l){
+                layers[l].w = weights[l].data();
+                layers[l].b = biases[l].data();
+            }
+
+            ana::sgd_trainer trainer(layers, threads);
+
+            for(std::size_t epoch = 0; epoch < 5; ++epoch){
+                for(auto& batch : sgd_batches){
+                    trainer.step(batch, sgd_parameters);
+                }
+            }
+
+            return weights;
+        };
+
+        auto single = train(1);
+        auto multiple = train(4);
+
+        float difference = 0.0f;
+
+        for(std::size_t l = 0; l < single.size(); ++l){
+            for(std::size_t i = 0; i < single[l].size(); ++i){
+                difference = std::max(difference, std::abs(single[l][i] - multiple[l][i]));
+            }
+        }
+
+        std::cout << "   sgd: the weights on 1 and 4 threads differ by at most " << difference << std::endl;
+
+        if(difference > 5e-7f){
+            std::cout << "error: the parallel SGD depends on the number of threads" << std::endl;
+            return 1;
+        }
+    }
+
+    //8. Parallel CD-1 pretraining of the first RBM (gaussian visible units), on the same cores
+
+    std::vector<float> cd_b(model.sizes[1]);
+    std::vector<float> cd_c(model.sizes[0]);
+
+    ana::cd_layer cd_layer{model.weights[0].data(), cd_b.data(), cd_c.data(), model.sizes[0], model.sizes[1], dll::unit_type::GAUSSIAN, dll::unit_type::BINARY};
+
+    std::vector<std::vector<float>> cd_batches;
+
+    for(std::size_t i = 0; i < arena.windows(); i += cd_batch_size){
+        auto rows = std::min(cd_batch_size, arena.windows() - i);
+        cd_batches.emplace_back(arena.window(i), arena.window(i) + rows * arena.window_size());
+    }
+
+    ana::cd_parameters cd_parameters{0.001f, 0.5f, 0.0002f};
+
+    for(auto threads : thread_counts){
+        suite.run("cd/threads=" + std::to_string(threads), "windows", 0, [&]{
+            ana::cd_trainer trainer(cd_layer, threads, cd_seed, 0);
+
+            ana::bounded_queue<std::vector<float>> batches(cd_batches.size());
+
+            for(auto& batch : cd_batches){
+                batches.push(batch);
+            }
+
+            batches.close();
+
+            return arena.windows() + (trainer.epoch(batches, cd_parameters) < 0.0);
+        });
+    }
+
+    //9. Writing of the features, sigmoid activations of a 500 units layer
+
+    std::size_t dims = 500;
+    std::vector<float> features(frames * dims);
+
+    std::mt19937 generator(42);
+    std::normal_distribution<float> distribution(0.0, 4.0);
+
+    for(auto& feature : features){
+        feature = 1.0f / (1.0f + std::exp(-distribution(generator)));
+    }
+
+    ana::text_features_writer text_writer;
+    ana::binary_features_writer float_writer(false);
+    ana::binary_features_writer half_writer(true);
+
+    auto feature_bytes = legacy_write(features, dims);
+
+    suite.run("write/ostream", "features", feature_bytes, [&]{ legacy_write(features, dims); return features.size(); });
+    suite.run("write/text", "features", feature_bytes, [&]{ writer_write(text_writer, features, dims); return features.size(); });
+    suite.run("write/float32", "features", 0, [&]{ writer_write(float_writer, features, dims); return features.size(); });
+    suite.run("write/float16", "features", 0, [&]{ writer_write(half_writer, features, dims); return features.size(); });
+
+    if(!save_file.empty()){
+        if(suite.save(save_file)){
+            std::cout << "Baseline saved to " << save_file << std::endl;
+        } else {
+            std::cout << "Impossible to write the baseline \"" << save_file << "\"" << std::endl;
+            return 1;
+        }
+    }
+
+    if(!baseline_file.empty() && !suite.compare(baseline_file, tolerance)){
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,135 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_ACTIVATION_STORE_HPP
+#define ANA_TEMPLATE_ACTIVATION_STORE_HPP
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdio>
+
+#include "config.hpp"
+#include "data.hpp"
+
+namespace ana {
+
+/*!
+ * \brief The activations of a layer for all the windows of the corpus, the
+ * input of the next layer during the layer-wise pretraining.
+ *
+ * The activations are kept in memory, or written to a file which is then
+ * memory mapped. The file is removed once mapped, it does not outlive the
+ * store.
+ */
+struct activation_store {
+    /*!
+     * \brief Create an empty store of rows of size values. If file is empty,
+     * the rows are kept in memory.
+     */
+    activation_store(std::size_t size, const std::string& file);
+    ~activation_store();
+
+    activation_store(const activation_store& rhs) = delete;
+    activation_store& operator=(const activation_store& rhs) = delete;
+
+    /*!
+     * \brief Append rows rows, stored as a row-major matrix
+     */
+    void append(const float* values, std::size_t rows);
+
+    /*!
+     * \brief End the appends and make the rows available
+     * \return false if the rows cannot be written or mapped
+     */
+    bool finish();
+
+    std::size_t rows() const {
+        return count;
+    }
+
+    /*!
+     * \brief The number of values of each row
+     */
+    std::size_t row_size() const {
+        return size;
+    }
+
+    const float* row(std::size_t i) const {
+        return data + i * size;
+    }
+
+private:
+    const std::size_t size;
+    const std::string file;
+
+    std::size_t count = 0;
+    bool valid = true;
+
+    std::vector<float> values;
+    std::FILE* fp = nullptr;
+
+    void* mapping = nullptr;
+    std::size_t mapping_size = 0;
+
+    const float* data = nullptr;
+};
+
+/*!
+ * \brief Input iterator over the rows of an activation store.
+ *
+ * Like the shard_iterator, dereferencing the iterator copies the current row
+ * in a buffer shared by the copies of the iterator.
+ */
+struct activation_iterator : std::iterator<std::input_iterator_tag, ana::sample_t> {
+    const activation_store& store;
+
+    std::size_t current_row = 0;
+
+    std::shared_ptr<ana::sample_t> buffer;
+
+    activation_iterator(const activation_store& store, std::size_t i = 0)
+            : store(store), current_row(i), buffer(std::make_shared<ana::sample_t>(store.row_size())) {
+        //Nothing else to init
+    }
+
+    activation_iterator(const activation_iterator& rhs) = default;
+    activation_iterator& operator=(const activation_iterator& rhs) = default;
+
+    bool operator==(const activation_iterator& rhs){
+        return current_row == rhs.current_row;
+    }
+
+    bool operator!=(const activation_iterator& rhs){
+        return !(*this == rhs);
+    }
+
+    ana::sample_t& operator*(){
+        auto row = store.row(current_row);
+        std::copy(row, row + store.row_size(), buffer->begin());
+        return *buffer;
+    }
+
+    ana::sample_t* operator->(){
+        return &**this;
+    }
+
+    activation_iterator& operator++(){
+        ++current_row;
+        return *this;
+    }
+
+    activation_iterator operator++(int){
+        activation_iterator it = *this;
+        ++(*this);
+        return it;
+    }
+};
+
+} //end of namespace ana
+
+#endif
@@ -0,0 +1,169 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_BATCH_HPP
+#define ANA_TEMPLATE_BATCH_HPP
+
+#include <vector>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+
+#include "dll/unit_type.hpp"
+
+#include "cpp_utils/data.hpp"
+
+#include "config.hpp"
+#include "blas.hpp"
+
+namespace ana {
+
+namespace detail {
+
+/*!
+ * \brief Apply the activation function of the given unit type to the rows x
+ * hidden matrix of the linear activations of a layer. The gaussian units are
+ * linear, the other unit types are not supported.
+ */
+inline void activate(dll::unit_type unit, float* output, std::size_t rows, std::size_t hidden){
+    if(unit == dll::unit_type::BINARY){
+        for(auto it = output; it != output + rows * hidden; ++it){
+            *it = 1.0f / (1.0f + std::exp(-*it));
+        }
+    } else if(unit == dll::unit_type::RELU){
+        for(auto it = output; it != output + rows * hidden; ++it){
+            *it = std::max(0.0f, *it);
+        }
+    } else if(unit == dll::unit_type::SOFTMAX){
+        for(std::size_t r = 0; r < rows; ++r){
+            auto first = output + r * hidden;
+            auto last = first + hidden;
+
+            auto max = *std::max_element(first, last);
+
+            float sum = 0.0f;
+            for(auto it = first; it != last; ++it){
+                *it = std::exp(*it - max);
+                sum += *it;
+            }
+
+            for(auto it = first; it != last; ++it){
+                *it /= sum;
+            }
+        }
+    } else if(unit != dll::unit_type::GAUSSIAN){
+        std::cout << "The batch forward pass does not support this unit type" << std::endl;
+        std::abort();
+    }
+}
+
+template<std::size_t I, typename DBN, cpp_enable_if((I == DBN::layers))>
+void forward_layers(DBN&, const float*, std::size_t, std::vector<float>*, std::size_t, std::size_t){
+    //Done
+}
+
+template<std::size_t I, typename DBN, cpp_enable_if((I < DBN::layers))>
+void forward_layers(DBN& dbn, const float* input, std::size_t rows, std::vector<float>* activations, std::size_t first, std::size_t last){
+    if(I == last){
+        return;
+    }
+
+    //The input is already the activations of the layer first - 1
+    if(I < first){
+        forward_layers<I + 1>(dbn, input, rows, activations, first, last);
+        return;
+    }
+
+    auto& rbm = dbn.template layer_get<I>();
+
+    using rbm_t = typename std::decay<decltype(rbm)>::type;
+
+    static_assert(std::is_same<typename rbm_t::weight, float>::value, "The batch forward pass only supports float weights");
+    static_assert(
+        rbm_t::hidden_unit == dll::unit_type::BINARY || rbm_t::hidden_unit == dll::unit_type::RELU || rbm_t::hidden_unit == dll::unit_type::SOFTMAX,
+        "The batch forward pass only supports binary, relu and softmax hidden units");
+
+    constexpr const std::size_t visible = rbm_t::num_visible;
+    constexpr const std::size_t hidden = rbm_t::num_hidden;
+
+    auto& output = activations[I];
+    output.resize(rows * hidden);
+
+    //output = input * w + b
+
+    for(std::size_t r = 0; r < rows; ++r){
+        std::copy(rbm.b.begin(), rbm.b.end(), output.begin() + r * hidden);
+    }
+
+    if(exact_inference){
+        ordered_gemm(false, false, rows, hidden, visible, 1.0f, input, visible, rbm.w.memory_start(), hidden, 1.0f, output.data(), hidden);
+    } else {
+        gemm(false, false, rows, hidden, visible, 1.0f, input, visible, rbm.w.memory_start(), hidden, 1.0f, output.data(), hidden);
+    }
+
+    activate(rbm_t::hidden_unit, output.data(), rows, hidden);
+
+    forward_layers<I + 1>(dbn, output.data(), rows, activations, first, last);
+}
+
+} //end of namespace detail
+
+/*!
+ * \brief Compute the activation probabilities of all the layers of a DBN for
+ * a batch of inputs at once, each layer being a single matrix-matrix product.
+ *
+ * The buffers are kept between the batches.
+ */
+template<typename DBN>
+struct batch_forward {
+    std::size_t rows = 0;
+    std::vector<float> activations[DBN::layers];
+
+    /*!
+     * \brief Forward rows inputs, stored as a row-major matrix
+     */
+    void run(DBN& dbn, const float* input, std::size_t rows){
+        run(dbn, input, rows, DBN::layers);
+    }
+
+    /*!
+     * \brief Forward rows inputs through the first layers layers only
+     */
+    void run(DBN& dbn, const float* input, std::size_t rows, std::size_t layers){
+        run_layers(dbn, input, rows, 0, layers);
+    }
+
+    /*!
+     * \brief Forward rows activations of the layer first - 1 through the
+     * layers [first, last)
+     */
+    void run_layers(DBN& dbn, const float* input, std::size_t rows, std::size_t first, std::size_t last){
+        this->rows = rows;
+        detail::forward_layers<0>(dbn, input, rows, activations, first, last);
+    }
+
+    /*!
+     * \brief Return the activations of the layer I of the row r
+     */
+    const float* activation(std::size_t I, std::size_t r) const {
+        return activations[I].data() + r * (activations[I].size() / rows);
+    }
+
+    /*!
+     * \brief Return the index of the most activated unit of the last layer for the row r
+     */
+    std::size_t predict(std::size_t r) const {
+        auto units = activations[DBN::layers - 1].size() / rows;
+        auto first = activation(DBN::layers - 1, r);
+        return std::distance(first, std::max_element(first, first + units));
+    }
+};
+
+} //end of namespace ana
+
+#endif
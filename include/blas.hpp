@@ -0,0 +1,36 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_BLAS_HPP
+#define ANA_TEMPLATE_BLAS_HPP
+
+#include <cstddef>
+
+namespace ana {
+
+/*!
+ * \brief Compute C = alpha * op(A) * op(B) + beta * C on row-major matrices,
+ * op(X) being X or its transpose. C is m x n and op(A) is m x k.
+ *
+ * MKL is used when ETL_MKL_MODE is defined.
+ */
+void gemm(bool trans_a, bool trans_b, std::size_t m, std::size_t n, std::size_t k,
+          float alpha, const float* a, std::size_t lda, const float* b, std::size_t ldb,
+          float beta, float* c, std::size_t ldc);
+
+/*!
+ * \brief Compute the same product as gemm, each value of C being summed in
+ * the order of k, as a product of one row of op(A) by op(B). The result of a
+ * row does not depend on the other rows, nor on the BLAS library.
+ */
+void ordered_gemm(bool trans_a, bool trans_b, std::size_t m, std::size_t n, std::size_t k,
+          float alpha, const float* a, std::size_t lda, const float* b, std::size_t ldb,
+          float beta, float* c, std::size_t ldc);
+
+} //end of namespace ana
+
+#endif
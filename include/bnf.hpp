@@ -0,0 +1,181 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file bnf.hpp
+ * \brief The binary features format (.bnfb files) and its reader.
+ *
+ * This header does not depend on the rest of the project, it can be copied
+ * in the projects consuming the generated features.
+ *
+ * A file is a bnf_header followed by count rows of dims values, stored in
+ * the byte order of the machine that generated them (little endian on x86),
+ * either as float32 or as float16 (IEEE 754 half precision).
+ */
+
+#ifndef ANA_TEMPLATE_BNF_HPP
+#define ANA_TEMPLATE_BNF_HPP
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+
+namespace ana {
+
+constexpr const char bnf_magic[8] = {'A', 'N', 'A', 'B', 'N', 'F', '\0', '\0'};
+
+//Must be incremented each time the layout of the format changes
+constexpr const std::uint32_t bnf_version = 1;
+
+constexpr const std::uint32_t bnf_float32 = 0;
+constexpr const std::uint32_t bnf_float16 = 1;
+
+struct bnf_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t layer;  ///< The layer of the network which generated the features
+    std::uint32_t dims;   ///< The number of values of each row
+    std::uint32_t type;   ///< bnf_float32 or bnf_float16
+    std::uint64_t count;  ///< The number of rows
+};
+
+static_assert(sizeof(bnf_header) == 32, "The bnf header must not be padded");
+
+/*!
+ * \brief Convert a float to half precision, rounding to nearest even
+ */
+inline std::uint16_t float_to_half(float value){
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    std::uint32_t sign = (bits >> 16) & 0x8000;
+    std::uint32_t exponent = (bits >> 23) & 0xFF;
+    std::uint32_t mantissa = bits & 0x7FFFFF;
+
+    //Inf and NaN
+    if(exponent == 0xFF){
+        return sign | 0x7C00 | (mantissa ? 0x200 | (mantissa >> 13) : 0);
+    }
+
+    int e = static_cast<int>(exponent) - 127 + 15;
+
+    //Overflow
+    if(e >= 31){
+        return sign | 0x7C00;
+    }
+
+    //Subnormal or zero
+    if(e <= 0){
+        if(e < -10){
+            return sign;
+        }
+
+        mantissa |= 0x800000;
+
+        std::uint32_t shift = 14 - e;
+        std::uint32_t half = mantissa >> shift;
+        std::uint32_t rest = mantissa & ((1u << shift) - 1);
+        std::uint32_t middle = 1u << (shift - 1);
+
+        if(rest > middle || (rest == middle && (half & 1))){
+            ++half;
+        }
+
+        return sign | half;
+    }
+
+    std::uint32_t half = (static_cast<std::uint32_t>(e) << 10) | (mantissa >> 13);
+    std::uint32_t rest = mantissa & 0x1FFF;
+
+    //The carry can propagate to the exponent, up to infinity, which is correct
+    if(rest > 0x1000 || (rest == 0x1000 && (half & 1))){
+        ++half;
+    }
+
+    return sign | half;
+}
+
+/*!
+ * \brief Convert a half precision value to float
+ */
+inline float half_to_float(std::uint16_t value){
+    std::uint32_t sign = static_cast<std::uint32_t>(value & 0x8000) << 16;
+    std::uint32_t exponent = (value >> 10) & 0x1F;
+    std::uint32_t mantissa = value & 0x3FF;
+
+    std::uint32_t bits;
+
+    if(exponent == 0x1F){
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    } else if(exponent){
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    } else if(mantissa){
+        //Normalize the subnormal value
+        exponent = 127 - 15 + 1;
+
+        while(!(mantissa & 0x400)){
+            mantissa <<= 1;
+            --exponent;
+        }
+
+        bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    } else {
+        bits = sign;
+    }
+
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+/*!
+ * \brief Read a binary features file.
+ *
+ * \param file The .bnfb file
+ * \param header The header of the file
+ * \param values The count x dims values of the file, converted to float
+ * \return true if the file has been read, false if it is not a valid file
+ */
+inline bool read_bnf(const std::string& file, bnf_header& header, std::vector<float>& values){
+    std::ifstream stream(file, std::ios::binary);
+
+    if(!stream.read(reinterpret_cast<char*>(&header), sizeof(header))){
+        return false;
+    }
+
+    if(std::memcmp(header.magic, bnf_magic, sizeof(bnf_magic)) != 0 || header.version != bnf_version){
+        return false;
+    }
+
+    auto n = static_cast<std::size_t>(header.count) * header.dims;
+
+    values.resize(n);
+
+    if(header.type == bnf_float32){
+        return static_cast<bool>(stream.read(reinterpret_cast<char*>(values.data()), n * sizeof(float)));
+    } else if(header.type == bnf_float16){
+        std::vector<std::uint16_t> halves(n);
+
+        if(!stream.read(reinterpret_cast<char*>(halves.data()), n * sizeof(std::uint16_t))){
+            return false;
+        }
+
+        for(std::size_t i = 0; i < n; ++i){
+            values[i] = half_to_float(halves[i]);
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+} //end of namespace ana
+
+#endif
@@ -0,0 +1,85 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_BOUNDED_QUEUE_HPP
+#define ANA_TEMPLATE_BOUNDED_QUEUE_HPP
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+namespace ana {
+
+/*!
+ * \brief A blocking FIFO queue holding at most capacity elements.
+ *
+ * Once closed, push() is not allowed anymore and pop() fails once the queue
+ * is empty.
+ */
+template<typename T>
+struct bounded_queue {
+    explicit bounded_queue(std::size_t capacity) : capacity(capacity ? capacity : 1) {}
+
+    bounded_queue(const bounded_queue& rhs) = delete;
+    bounded_queue& operator=(const bounded_queue& rhs) = delete;
+
+    void push(T value){
+        std::unique_lock<std::mutex> lock(mutex);
+
+        cv_push.wait(lock, [this](){ return values.size() < capacity; });
+
+        values.push_back(std::move(value));
+
+        lock.unlock();
+        cv_pop.notify_one();
+    }
+
+    /*!
+     * \brief Wait for an element and pop it
+     * \return false if the queue is closed and empty
+     */
+    bool pop(T& value){
+        std::unique_lock<std::mutex> lock(mutex);
+
+        cv_pop.wait(lock, [this](){ return !values.empty() || closed; });
+
+        if(values.empty()){
+            return false;
+        }
+
+        value = std::move(values.front());
+        values.pop_front();
+
+        lock.unlock();
+        cv_push.notify_one();
+
+        return true;
+    }
+
+    void close(){
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            closed = true;
+        }
+
+        cv_pop.notify_all();
+    }
+
+private:
+    const std::size_t capacity;
+    bool closed = false;
+
+    std::deque<T> values;
+
+    std::mutex mutex;
+    std::condition_variable cv_push;
+    std::condition_variable cv_pop;
+};
+
+} //end of namespace ana
+
+#endif
@@ -0,0 +1,39 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_CACHE_HPP
+#define ANA_TEMPLATE_CACHE_HPP
+
+#include <vector>
+#include <string>
+
+#include "window_arena.hpp"
+
+namespace ana {
+
+/*!
+ * \brief Load the windows of the given .feat file from its binary cache.
+ *
+ * The cache is only used if it was built from the same file (path, size and
+ * modification time) with the same N, Stride and Features.
+ *
+ * \param file The .feat file
+ * \param dropped Indicates if the <sil> windows have been dropped
+ * \param windows The arena in which the windows are loaded
+ * \param frames Set to the number of frames of the data file
+ * \return true if the cache was valid and has been loaded, false otherwise
+ */
+bool load_cached_windows(const std::string& file, bool dropped, window_arena& windows, std::size_t& frames);
+
+/*!
+ * \brief Store the windows of the given .feat file in its binary cache.
+ */
+void store_cached_windows(const std::string& file, bool dropped, const window_arena& windows, std::size_t frames);
+
+} //end of namespace ana
+
+#endif
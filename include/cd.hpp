@@ -0,0 +1,235 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_CD_HPP
+#define ANA_TEMPLATE_CD_HPP
+
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <type_traits>
+#include <cstdint>
+
+#include "dll/unit_type.hpp"
+#include "dll/rbm_traits.hpp"
+
+#include "config.hpp"
+#include "checkpoint.hpp"
+#include "parallel.hpp"
+#include "bounded_queue.hpp"
+
+namespace ana {
+
+/*!
+ * \brief A RBM trained by the contrastive divergence: a visible x hidden
+ * row-major weight matrix, the hidden biases (b) and the visible biases (c)
+ */
+struct cd_layer {
+    float* w;
+    float* b;
+    float* c;
+    std::size_t visible;
+    std::size_t hidden;
+    dll::unit_type visible_unit;
+    dll::unit_type hidden_unit;
+};
+
+/*!
+ * \brief The parameters of an update, as in the CD of DLL
+ */
+struct cd_parameters {
+    float learning_rate;
+    float momentum;
+    float weight_cost;  ///< The L2 weight decay (0 for none)
+};
+
+/*!
+ * \brief Parallel CD-1 training of a RBM.
+ *
+ * Each mini-batch is split between the threads, which compute the gradients
+ * of their rows in their own buffers. The gradients are then reduced, each
+ * thread summing a part of the weights, and the momentum and weight decay
+ * update is the same as with a single thread.
+ *
+ * The hidden units are sampled from a counter-based generator, the random
+ * value of a unit only depends on the seed, on the index of the layer, on the
+ * epoch and on the position of the window in the epoch. The training is then
+ * the same with any number of threads.
+ *
+ * The trainer counts its epochs and keeps its momentum increments, a layer
+ * trained in several parts uses the same trainer for all of them, and its
+ * state() is saved in the checkpoints to restore() it on resume.
+ */
+struct cd_trainer {
+    cd_trainer(cd_layer layer, std::size_t threads, std::size_t seed, std::size_t index);
+
+    std::size_t threads() const {
+        return pool.size();
+    }
+
+    /*!
+     * \brief Train on one mini-batch of windows, stored as a row-major matrix
+     * \return the sum of the squared reconstruction errors of the batch
+     */
+    double step(const std::vector<float>& batch, const cd_parameters& parameters);
+
+    /*!
+     * \brief Return the number of epochs trained
+     */
+    std::size_t epochs() const {
+        return trained_epochs;
+    }
+
+    /*!
+     * \brief Start the given epoch of the layer, the next windows are sampled
+     * from the stream of the epoch
+     */
+    void start_epoch(std::size_t epoch);
+
+    /*!
+     * \brief Train the next epoch on all the mini-batches of the queue, until
+     * it is closed
+     * \return the sum of the squared reconstruction errors
+     */
+    double epoch(bounded_queue<std::vector<float>>& batches, const cd_parameters& parameters);
+
+    /*!
+     * \brief Return the epochs and the momentum increments of the trainer
+     */
+    trainer_state state() const;
+
+    /*!
+     * \brief Continue the training from the given state
+     * \return false if the state does not match the layer
+     */
+    bool restore(const trainer_state& state);
+
+private:
+    //The buffers of one thread
+    struct worker_t {
+        std::vector<float> h1_a;
+        std::vector<float> h1_s;
+        std::vector<float> v2_a;
+        std::vector<float> h2_a;
+
+        std::vector<float> w_grad;
+        std::vector<float> b_grad;
+        std::vector<float> c_grad;
+
+        double error = 0.0;
+    };
+
+    void gradients(worker_t& worker, const float* v1, std::size_t rows, std::size_t first_row);
+
+    const cd_layer layer;
+
+    std::vector<worker_t> workers;
+
+    std::vector<float> w_inc;
+    std::vector<float> b_inc;
+    std::vector<float> c_inc;
+
+    const std::uint64_t layer_stream;   ///< The key of the sampling of the layer
+    std::uint64_t stream = 0;           ///< The key of the sampling of the current epoch
+    std::size_t windows = 0;            ///< The number of windows already trained in the epoch
+    std::size_t trained_epochs = 0;     ///< The number of epochs trained, the next epoch sampled by epoch()
+
+    worker_pool pool;
+};
+
+/*!
+ * \brief Return the layer of the parallel CD for the given RBM
+ */
+template<typename RBM>
+cd_layer make_cd_layer(RBM& rbm){
+    static_assert(std::is_same<typename RBM::weight, float>::value, "The parallel CD only supports float weights");
+
+    return {rbm.w.memory_start(), rbm.b.memory_start(), rbm.c.memory_start(), RBM::num_visible, RBM::num_hidden, RBM::visible_unit, RBM::hidden_unit};
+}
+
+/*!
+ * \brief Train the RBM for epochs more epochs with the given trainer of its
+ * layer, with mini-batches of cd_batch_size windows. The windows are read by a
+ * separate thread from the given iterators.
+ *
+ * The momentum schedule of the RBM continues from the epochs already trained
+ * by the trainer.
+ *
+ * \return the reconstruction error of the last epoch
+ */
+template<typename RBM, typename Iterator>
+double parallel_train_rbm(RBM& rbm, cd_trainer& cd, Iterator first, Iterator last, std::size_t epochs){
+    auto decay = dll::rbm_traits<RBM>::decay() != dll::decay_type::NONE;
+
+    double error = 0.0;
+
+    for(std::size_t e = 0; e < epochs; ++e){
+        auto start = std::chrono::steady_clock::now();
+
+        auto epoch = cd.epochs();
+
+        rbm.momentum = epoch < rbm.final_momentum_epoch ? rbm.initial_momentum : rbm.final_momentum;
+
+        cd_parameters parameters{float(rbm.learning_rate), float(rbm.momentum), decay ? float(rbm.l2_weight_cost) : 0.0f};
+
+        bounded_queue<std::vector<float>> batches(2 * cd.threads());
+
+        std::size_t windows = 0;
+
+        std::thread reader([&](){
+            std::vector<float> batch;
+
+            for(auto it = first; it != last; ++it){
+                batch.insert(batch.end(), it->begin(), it->end());
+
+                if(++windows % cd_batch_size == 0){
+                    batches.push(std::move(batch));
+                    batch = std::vector<float>();
+                }
+            }
+
+            if(!batch.empty()){
+                batches.push(std::move(batch));
+            }
+
+            batches.close();
+        });
+
+        auto squared = cd.epoch(batches, parameters);
+
+        reader.join();
+
+        error = windows ? squared / (windows * double(RBM::num_visible)) : 0.0;
+
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "epoch " << epoch << " - Reconstruction error: " << error << " Time " << ms << "ms" << std::endl;
+    }
+
+    return error;
+}
+
+/*!
+ * \brief Train the RBM with the parallel CD-1 for epochs epochs, with a new
+ * trainer. index is the index of the RBM in its DBN, for each layer to draw
+ * other samples.
+ *
+ * \return the reconstruction error of the last epoch
+ */
+template<typename RBM, typename Iterator>
+double parallel_train_rbm(RBM& rbm, Iterator first, Iterator last, std::size_t epochs, std::size_t index = 0){
+    cd_trainer cd(make_cd_layer(rbm), cd_threads, cd_seed, index);
+
+    std::cout << "Parallel CD with " << cd.threads() << " threads" << std::endl;
+
+    return parallel_train_rbm(rbm, cd, first, last, epochs);
+}
+
+} //end of namespace ana
+
+#endif
@@ -0,0 +1,93 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_CHECKPOINT_HPP
+#define ANA_TEMPLATE_CHECKPOINT_HPP
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "config.hpp"
+
+namespace ana {
+
+enum class training_stage : std::size_t {
+    PRETRAINING,
+    FINE_TUNING,
+    DONE
+};
+
+/*!
+ * \brief The state of a parallel trainer (cd_trainer or sgd_trainer), kept
+ * between the parts of a layer or of the fine-tuning
+ */
+struct trainer_state {
+    std::size_t epochs = 0;                         ///< The number of epochs trained, the counter of the sampling
+    std::vector<std::vector<float>> increments;     ///< The momentum increments
+};
+
+/*!
+ * \brief The state of a training, from which it can be resumed
+ */
+struct checkpoint_t {
+    training_stage stage = training_stage::PRETRAINING;
+    std::size_t layer = 0;          ///< The layer being pretrained
+    std::size_t epoch = 0;          ///< The number of epochs done in the layer or in the fine-tuning
+    std::size_t shuffle_epoch = 0;  ///< The number of epochs drawn from the shuffled windows of the stage
+    std::size_t input = 0;          ///< The size of the input of the network, the window size
+    trainer_state trainer;          ///< The parallel trainer in the middle of a layer or of the fine-tuning
+    std::string labels;         ///< The label vocabulary, one label per line
+    std::string network;        ///< The DBN, as stored by dbn.store(stream)
+};
+
+/*!
+ * \brief Load the checkpoint stored in the given file
+ * \return false if the file cannot be read or is not a valid checkpoint
+ */
+bool load_checkpoint(const std::string& file, checkpoint_t& checkpoint);
+
+/*!
+ * \brief Write the checkpoints to a file from a background thread.
+ *
+ * Each checkpoint is written to a temporary file which is then renamed, the
+ * file always contains a complete checkpoint. If a new checkpoint is pushed
+ * while the previous one is still pending, only the new one is written.
+ */
+struct checkpoint_writer {
+    explicit checkpoint_writer(const std::string& file);
+
+    checkpoint_writer(const checkpoint_writer& rhs) = delete;
+    checkpoint_writer& operator=(const checkpoint_writer& rhs) = delete;
+
+    /*!
+     * \brief Write the pending checkpoint and stop the thread
+     */
+    ~checkpoint_writer();
+
+    void push(checkpoint_t checkpoint);
+
+private:
+    void run();
+
+    const std::string file;
+
+    std::mutex mutex;
+    std::condition_variable ready;
+
+    bool pending = false;
+    bool stopped = false;
+    checkpoint_t next;
+
+    std::thread thread;
+};
+
+} //end of namespace ana
+
+#endif
@@ -8,6 +8,10 @@
 #ifndef ANA_TEMPLATE_CONFIG_HPP
 #define ANA_TEMPLATE_CONFIG_HPP
 
+//The default shape of the windows: N frames of Features features, every Stride frames.
+//N, Features, Stride, lazy_pt and lazy_ft are only defaults, they can be changed at runtime with
+//a settings file or the command line (see settings.hpp). The normalization is unrolled for
+//Features and the DBN must be compiled for the number of values of the windows (see main.cpp)
 static constexpr const std::size_t N = 11;
 static constexpr const std::size_t Features = 43;
 static constexpr const std::size_t Stride = 11;
@@ -24,9 +28,177 @@ static constexpr const bool lazy_pt = true;
 //will be read and normalized at least once each epoch. The overhead may be very large.
 static constexpr const bool lazy_ft = true;
 
+//Putting auto_loading = true counts the lines of the data files before the training, without parsing them,
+//and chooses the eager or the lazy loading of each phase instead of lazy_pt and lazy_ft: the pretraining and
+//then the fine-tuning are read at once if their windows fit in eager_memory_bytes. The counts are also used
+//to allocate the windows read at once in one go.
+static constexpr const bool auto_loading = false;
+
+//The memory of the windows read at once (0 means 80% of the available memory of the machine)
+static constexpr const std::size_t eager_memory_bytes = 0;
+
 //Putting drop_sil = true will drop all <sil> from training
 static constexpr const bool drop_sil_windows = false;
 
+//The normalization of each feature of the files to zero mean and unit variance:
+// - normalization_mode::UTTERANCE uses the statistics of the file itself
+// - normalization_mode::GLOBAL uses the statistics of all the files
+// - normalization_mode::SPEAKER uses the statistics of the files of the same speaker (the same directory path)
+//The GLOBAL and SPEAKER statistics are computed once with the "stats" action and stored in stats_file,
+//reading a file does not need any statistics pass then
+enum class normalization_mode { UTTERANCE, GLOBAL, SPEAKER };
+
+static constexpr const normalization_mode normalization = normalization_mode::UTTERANCE;
+
+static const std::string stats_file = "stats.dat";
+
+//Putting cache_windows = true stores the normalized windows of each data file in a binary cache
+//file the first time it is read. The following reads (each epoch in lazy mode) directly load
+//the windows from the cache, without parsing and normalizing the text file again.
+static constexpr const bool cache_windows = false;
+
+//The directory in which the window cache files are stored. If empty, each cache file is
+//stored next to its data file
+static const std::string cache_directory = "";
+
+//The number of bytes of the memory cache of the lazy iterators (0 disables it). The normalized windows and
+//the labels of the files are kept in memory as long as they fit. Once the cache is full, a file only replaces
+//other files if it has been read more often, the files in the cache stay there from an epoch to the next.
+static constexpr const std::size_t memory_cache_bytes = 0;
+
+//Putting use_shards = true makes the lazy iterators read the windows from the shard files (built
+//with the "shard" action) instead of the data files. A shard holds the normalized frames of all
+//the files once and is memory mapped: the frames of overlapping windows are only stored once, and each
+//window is only copied in a single reused buffer when the DBN reads it. The training stops if the shard
+//is missing or was built from other files, with another window shape or with another normalization.
+static constexpr const bool use_shards = false;
+
+static const std::string pt_shard_file = "pt.shard";
+static const std::string ft_shard_file = "ft.shard";
+
+//Putting prefetch = true makes the lazy iterators load and normalize the next files in background
+//threads while the windows of the current file are used for training
+static constexpr const bool prefetch = true;
+
+//The maximum number of files loaded ahead of the current file
+static constexpr const std::size_t prefetch_depth = 4;
+
+//The number of threads loading the sample files
+static constexpr const std::size_t prefetch_workers = 2;
+
+//Putting shuffle = true makes the lazy iterators visit the files in a different order each epoch
+//and draw the windows at random from a buffer filled with the windows of several files
+static constexpr const bool shuffle = false;
+
+//The seed of the shuffling, the order of each epoch only depends on the seed and on the epoch
+static constexpr const std::size_t shuffle_seed = 42;
+
+//The number of windows of the shuffle buffer
+static constexpr const std::size_t shuffle_buffer = 10000;
+
+//The number of files whose windows are interleaved in the shuffle buffer
+static constexpr const std::size_t shuffle_files = 4;
+
+//The number of threads scanning the directories of the list files (0 means all the cores)
+static constexpr const std::size_t scan_threads = 0;
+
+//Putting file_manifest = true stores the files found for a list file in a manifest next to it (list.manifest),
+//with the modification times of the scanned directories. The following runs read the manifest instead
+//of scanning the directories again as long as none of the directories has changed.
+static constexpr const bool file_manifest = false;
+
+//The number of threads used to read the data files when they are not read lazily (0 means all the cores)
+static constexpr const std::size_t load_threads = 0;
+
+//The number of windows evaluated at once by the batched inference
+static constexpr const std::size_t inference_batch = 256;
+
+//The number of threads used for the inference (0 means all the cores)
+static constexpr const std::size_t inference_threads = 0;
+
+//Putting exact_inference = true makes the batched inference sum each activation in the order of the inputs,
+//like the product of one window by dbn.predict, so that the accuracy and the error table of the test do
+//not depend on the batch size, the threads or MKL. Putting it to false uses MKL for the batched products,
+//which is faster, but reorders the sums: a window close to a decision boundary may then be predicted differently.
+static constexpr const bool exact_inference = true;
+
+//Putting binary_features = true writes the generated features in the binary format described in
+//bnf.hpp (.bnfb files) instead of text (.bnf files). The binary files are much smaller and faster
+//to write and to read.
+static constexpr const bool binary_features = false;
+
+//Putting half_features = true stores the binary features as float16 instead of float32
+static constexpr const bool half_features = false;
+
+//The number of threads of each stage of the feature generation (0 means all the cores). This can
+//be changed with the --jobs=N option
+static constexpr const std::size_t feature_jobs = 0;
+
+//Putting checkpointing = true pretrains the layers one after another and saves a checkpoint of the training
+//(the network, the label vocabulary, the layer and the epoch) at the end of each layer, at the end of the
+//fine-tuning and every checkpoint_epochs epochs. The checkpoints are written to checkpoint_file by a
+//background thread. The "resume" action continues the training from the last checkpoint. Without
+//activation_stores, the input of each upper layer is forwarded through the lower layers again at each epoch,
+//by blocks of inference_batch windows.
+static constexpr const bool checkpointing = false;
+
+//The number of epochs between two checkpoints of a layer or of the fine-tuning (0 means only at the end). Only
+//the parallel trainers (parallel_cd and parallel_sgd) are checkpointed in the middle of a layer or of the
+//fine-tuning, with their momentum and their sampling counter. The trainers of DLL cannot be kept between two
+//calls, they are only checkpointed at the end of each layer and of the fine-tuning.
+static constexpr const std::size_t checkpoint_epochs = 1;
+
+static const std::string checkpoint_file = "checkpoint.dat";
+
+//Putting activation_stores = true pretrains the layers one after another and, once a layer is trained, computes
+//its activations for all the windows once. The next layer is trained from these activations instead of reading
+//the windows and forwarding them through the lower layers at each epoch.
+static constexpr const bool activation_stores = false;
+
+//The directory of the activation stores, which are written there and memory mapped (empty means in memory)
+static const std::string activation_directory = "";
+
+//Putting parallel_sgd = true fine-tunes the DBN with the data-parallel SGD of sgd.hpp instead of the SGD of
+//DLL. Each mini-batch of sgd_batch_size windows is split between sgd_threads threads and their gradients
+//are summed before the update. With a small mini-batch, each thread only has a few windows, a larger
+//sgd_batch_size scales better on many cores.
+static constexpr const bool parallel_sgd = false;
+
+//Putting hogwild_sgd = true makes each thread of the parallel SGD train on its own mini-batches and update
+//the shared weights without synchronization. The updates of the threads can overwrite each other.
+static constexpr const bool hogwild_sgd = false;
+
+//The number of threads of the parallel SGD (0 means all the cores)
+static constexpr const std::size_t sgd_threads = 0;
+
+//The number of windows of each mini-batch of the parallel SGD. It is not taken from the DBN, it must be
+//changed together with the dll::batch_size<100> of the DBN in main.cpp to keep the same mini-batches
+static constexpr const std::size_t sgd_batch_size = 100;
+
+//Putting parallel_cd = true pretrains the layers one after another with the parallel CD-1 of cd.hpp instead of the
+//CD of DLL. Each mini-batch of cd_batch_size windows is split between cd_threads threads and their gradients are
+//summed before the update
+static constexpr const bool parallel_cd = false;
+
+//The number of threads of the parallel CD (0 means all the cores)
+static constexpr const std::size_t cd_threads = 0;
+
+//The number of windows of each mini-batch of the parallel CD. Like sgd_batch_size, it is not taken from the
+//RBMs and must be changed together with their dll::batch_size<50> in main.cpp
+static constexpr const std::size_t cd_batch_size = 50;
+
+//The seed of the sampling of the hidden units by the parallel CD, each layer and each epoch draw other samples
+static constexpr const std::size_t cd_seed = 42;
+
+//Putting telemetry_enabled = true times the phases of the run (parsing, normalization, training, ...) and
+//counts the bytes, frames, windows, files and allocations. At the end of the run, the values are written
+//to telemetry_file.json and telemetry_file.csv and a summary is printed. When it is false, the timers and
+//the counters are compiled out. The allocations are only counted when the program is built with
+//ANA_COUNT_ALLOCATIONS (make COUNT_ALLOCATIONS=1), which replaces the global operator new.
+static constexpr const bool telemetry_enabled = false;
+
+static const std::string telemetry_file = "telemetry";
+
 static const std::string features_replace_source = "/home/wichtounet/datasets/ana";
 static const std::string features_replace_target = "/home/wichtounet/datasets/features";
 
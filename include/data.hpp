@@ -11,29 +11,123 @@
 #include <vector>
 #include <string>
 #include <utility>
-#include <unordered_map>
+#include <memory>
 
 #include "etl/etl.hpp"
 
+#include "window_arena.hpp"
+#include "settings.hpp"
+
 namespace ana {
 
 using sample_t = etl::dyn_vector<float>;
 using label_t = std::size_t;
 
+struct frames_t;
+
 using files_t = std::vector<std::string>;
 using paired_files_t = std::pair<files_t, files_t>;
 
+/*!
+ * \brief The windows of a pair of samples and labels files
+ */
+struct utterance_t {
+    window_arena windows;
+    std::vector<label_t> labels;
+    std::size_t frames = 0; ///< The number of frames of the samples file
+};
+
+/*!
+ * \brief Access of the iterators to the windows (sample_t) or to the labels
+ * (label_t) of an utterance.
+ *
+ * The windows stay in the arena of the utterance, a window is copied in the
+ * buffer of the iterator when it is dereferenced, so that the iterators do
+ * not allocate one sample per window.
+ */
+template<typename T>
+struct utterance_values;
+
+template<>
+struct utterance_values<sample_t> {
+    static std::size_t size(const utterance_t& utterance){
+        return utterance.windows.windows();
+    }
+
+    static std::shared_ptr<sample_t> buffer(){
+        return std::make_shared<sample_t>(settings().window_size());
+    }
+
+    static sample_t& get(const utterance_t& utterance, std::size_t i, const std::shared_ptr<sample_t>& buffer){
+        utterance.windows.copy_window(i, *buffer);
+        return *buffer;
+    }
+};
+
+template<>
+struct utterance_values<label_t> {
+    static std::size_t size(const utterance_t& utterance){
+        return utterance.labels.size();
+    }
+
+    //The labels are not copied
+    static std::shared_ptr<label_t> buffer(){
+        return nullptr;
+    }
+
+    static label_t& get(utterance_t& utterance, std::size_t i, const std::shared_ptr<label_t>& /*buffer*/){
+        return utterance.labels[i];
+    }
+};
+
 paired_files_t get_paired_files(const std::string& ft_samples_file, const std::string& ft_labels_file);
 
+/*!
+ * \brief Pair each samples file with its labels file.
+ *
+ * A labels file is the equivalent of a samples file if they have the same
+ * path without extension, or the same path without extension and without
+ * the parent directory. The first equivalent labels file is used.
+ */
+paired_files_t pair_files(const files_t& samples_files, const files_t& labels_files);
+
+struct data_scan;
+
+/*!
+ * \brief Read the windows and the labels of the phases that are not lazy.
+ *
+ * With the scan of the files, the windows are stored directly at their place
+ * in vectors allocated once.
+ */
 void read_data(
     const std::string& pt_samples_file, const paired_files_t& ft_files,
     std::vector<sample_t>& pt_samples, std::vector<sample_t>& ft_samples, std::vector<std::size_t>& ft_labels,
-    bool lazy_pretraining = false, bool lazy_fine_tuning = false);
+    bool lazy_pretraining = false, bool lazy_fine_tuning = false, const data_scan* scan = nullptr);
 
-std::unordered_map<std::size_t, std::string> reverse_mapper();
+/*!
+ * \brief Read the windows of the given file into the arena.
+ *
+ * The files read only once (cached = false) do not go through the memory cache.
+ *
+ * \return the number of frames of the file
+ */
+std::size_t read_windows(const paired_files_t& files, const std::string& file, window_arena& windows, bool pt, bool cached = true);
 
-void read_samples(const paired_files_t& files, const std::string& file, std::vector<ana::sample_t>& samples, bool pt);
+/*!
+ * \brief Read the windows of the given file and append them to samples.
+ *
+ * \return the number of frames of the file
+ */
+std::size_t read_samples(const paired_files_t& files, const std::string& file, std::vector<ana::sample_t>& samples, bool pt, bool cached = true);
 void read_labels(const std::string& file, std::vector<std::size_t>& labels);
+void read_labels_str(const std::string& file, std::vector<std::string>& labels);
+void map_labels(const std::vector<std::string>& str_labels, std::vector<std::size_t>& labels);
+
+/*!
+ * \brief Read the windows and the labels of a pair of files in the utterance,
+ * replacing its content.
+ */
+void read_utterance(const std::string& samples_file, const std::string& labels_file, utterance_t& utterance, bool cached = true);
 
 } //end of namespace ana
 
@@ -0,0 +1,80 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_FEATURES_WRITER_HPP
+#define ANA_TEMPLATE_FEATURES_WRITER_HPP
+
+#include <string>
+
+namespace ana {
+
+/*!
+ * \brief Encode the features of a layer in the bytes of a features file.
+ *
+ * The features of a layer are encoded with begin(), then write() for each
+ * batch of rows and finally end().
+ */
+struct features_writer {
+    virtual ~features_writer(){}
+
+    /*!
+     * \brief The extension of the features files
+     */
+    virtual const char* extension() const = 0;
+
+    virtual void begin(std::string& out) const = 0;
+
+    /*!
+     * \brief Append rows x dims row-major values
+     */
+    virtual void write(std::string& out, const float* values, std::size_t rows, std::size_t dims) const = 0;
+
+    virtual void end(std::string& out, std::size_t layer, std::size_t dims, std::size_t count) const = 0;
+};
+
+/*!
+ * \brief Writes the features as text, one row per line, each value being
+ * followed by a comma.
+ *
+ * The values are written with the shortest representation that reads back
+ * to the same float.
+ */
+struct text_features_writer final : features_writer {
+    const char* extension() const override;
+    void begin(std::string& out) const override;
+    void write(std::string& out, const float* values, std::size_t rows, std::size_t dims) const override;
+    void end(std::string& out, std::size_t layer, std::size_t dims, std::size_t count) const override;
+};
+
+/*!
+ * \brief Writes the features in the binary format described in bnf.hpp
+ */
+struct binary_features_writer final : features_writer {
+    const bool half;
+
+    explicit binary_features_writer(bool half) : half(half) {}
+
+    const char* extension() const override;
+    void begin(std::string& out) const override;
+    void write(std::string& out, const float* values, std::size_t rows, std::size_t dims) const override;
+    void end(std::string& out, std::size_t layer, std::size_t dims, std::size_t count) const override;
+};
+
+/*!
+ * \brief Write the shortest representation of value that reads back to the
+ * same float in buffer (at least 32 characters) and return its length.
+ */
+std::size_t format_float(float value, char* buffer);
+
+/*!
+ * \brief Return the features writer selected in the configuration
+ */
+const features_writer& configured_features_writer();
+
+} //end of namespace ana
+
+#endif
@@ -0,0 +1,44 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_FRAMES_HPP
+#define ANA_TEMPLATE_FRAMES_HPP
+
+#include <vector>
+#include <string>
+
+#include "config.hpp"
+
+namespace ana {
+
+/*!
+ * \brief The frames of one .feat file, stored as a flat row-major matrix
+ * of rows x columns floats.
+ */
+struct frames_t {
+    std::vector<float> values;
+    std::size_t rows = 0;
+    std::size_t columns = Features;
+
+    float* row(std::size_t i){
+        return values.data() + i * columns;
+    }
+
+    const float* row(std::size_t i) const {
+        return values.data() + i * columns;
+    }
+};
+
+/*!
+ * \brief Read the frames of the given file, each frame must have the
+ * configured number of features.
+ */
+void read_frames(const std::string& file, frames_t& frames);
+
+} //end of namespace ana
+
+#endif
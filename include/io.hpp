@@ -15,6 +15,8 @@ namespace ana {
 
 std::vector<std::string> get_files(const std::string& file, const std::vector<std::string>& extension);
 
+std::size_t file_size(const std::string& file);
+
 } //end of namespace ana
 
 #endif
@@ -13,6 +13,7 @@
 #include <mutex>
 
 #include "data.hpp"
+#include "telemetry.hpp"
 
 namespace ana {
 
@@ -64,6 +65,9 @@ struct label_iterator : std::iterator<std::input_iterator_tag, ana::label_t> {
             current_label = 0;
 
             if(current_file < file_names.second.size()){
+                phase_timer timer(phase::FILE_SWITCH);
+                count(counter::FILE_SWITCHES);
+
                 read_labels(file_names.second[current_file], labels);
             }
         } else {
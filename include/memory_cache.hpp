@@ -0,0 +1,123 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_MEMORY_CACHE_HPP
+#define ANA_TEMPLATE_MEMORY_CACHE_HPP
+
+#include <vector>
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+
+#include "config.hpp"
+
+namespace ana {
+
+struct window_arena;
+
+/*!
+ * \brief A cache of the decoded files in memory, holding at most a given
+ * number of bytes: the normalized windows of the samples files and the labels
+ * of the labels files.
+ *
+ * An LRU cache is useless for the lazy training, which reads all the files
+ * in the same order at each epoch: each file would be evicted before being
+ * read again. The cache counts the reads of each file and a file only
+ * replaces the least recently used files if it has been read more often
+ * than them. Once the cache is full, the files in the cache stay there for
+ * the next epochs instead of being replaced by each new file.
+ *
+ * The cache is shared by all the threads.
+ */
+struct memory_cache_t {
+    std::atomic<std::size_t> hits;
+    std::atomic<std::size_t> misses;
+    std::atomic<std::size_t> evictions;     ///< The number of files evicted to store another file
+    std::atomic<std::size_t> rejections;    ///< The number of files not stored because they are read less often
+
+    explicit memory_cache_t(std::size_t capacity);
+
+    memory_cache_t(const memory_cache_t& rhs) = delete;
+    memory_cache_t& operator=(const memory_cache_t& rhs) = delete;
+
+    /*!
+     * \brief Load the windows of the given samples file in the arena
+     * \return true if the file was in the cache
+     */
+    bool load(const std::string& file, bool dropped, window_arena& windows, std::size_t& frames);
+
+    /*!
+     * \brief Store the windows of the given samples file, if they are admitted
+     */
+    void store(const std::string& file, bool dropped, const window_arena& windows, std::size_t frames);
+
+    /*!
+     * \brief Append the labels of the given labels file to labels
+     * \return true if the file was in the cache
+     */
+    bool load(const std::string& file, std::vector<std::size_t>& labels);
+
+    /*!
+     * \brief Store the labels of the given labels file, if they are admitted
+     */
+    void store(const std::string& file, const std::vector<std::size_t>& labels);
+
+    /*!
+     * \brief Return the number of bytes currently used
+     */
+    std::size_t size();
+
+    void print(const std::string& phase);
+
+private:
+    struct entry_t {
+        std::string key;
+        std::vector<float> windows;
+        std::vector<std::size_t> labels;
+        std::size_t frames = 0;
+
+        std::size_t bytes() const {
+            return key.size() + windows.size() * sizeof(float) + labels.size() * sizeof(std::size_t);
+        }
+    };
+
+    using entry_ptr = std::shared_ptr<const entry_t>;
+
+    entry_ptr find(const std::string& key);
+    void insert(entry_ptr entry);
+
+    //Return true if an entry of bytes bytes would be stored, the victims being the entries from victims to the end
+    bool admit(const std::string& key, std::size_t bytes, std::list<entry_ptr>::iterator& victims);
+
+    //Check the admission of an entry before it is built
+    bool admissible(const std::string& key, std::size_t bytes);
+
+    const std::size_t capacity;
+    std::size_t used = 0;
+
+    std::mutex mutex;
+
+    //The entries, the most recently used first
+    std::list<entry_ptr> entries;
+    std::unordered_map<std::string, std::list<entry_ptr>::iterator> index;
+
+    //The number of reads of each file, halved regularly so that old reads count less
+    std::unordered_map<std::string, std::size_t> frequencies;
+    std::size_t reads = 0;
+};
+
+/*!
+ * \brief The memory cache of the program, of memory_cache_bytes bytes
+ */
+memory_cache_t& memory_cache();
+
+} //end of namespace ana
+
+#endif
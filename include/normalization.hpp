@@ -0,0 +1,100 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_NORMALIZATION_HPP
+#define ANA_TEMPLATE_NORMALIZATION_HPP
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+#include "config.hpp"
+
+namespace ana {
+
+struct frames_t;
+
+/*!
+ * \brief The count, mean and sum of squared deviations of each feature of a
+ * set of frames.
+ */
+struct feature_stats {
+    std::size_t count = 0;
+    std::vector<double> mean;
+    std::vector<double> m2;
+
+    /*!
+     * \brief Create empty stats for the configured number of features
+     */
+    feature_stats();
+
+    /*!
+     * \brief Add all the frames in a single row-major pass
+     */
+    void add(const frames_t& frames);
+
+    /*!
+     * \brief Add the frames of other stats (Chan et al. parallel update)
+     */
+    void merge(const feature_stats& other);
+};
+
+/*!
+ * \brief The normalization of each feature to zero mean and unit variance
+ */
+struct normalization_t {
+    std::vector<float> mean;
+    std::vector<float> scale; ///< The inverse of the standard deviation, 1 if it is zero
+
+    explicit normalization_t(const feature_stats& stats);
+
+    void apply(frames_t& frames) const;
+};
+
+/*!
+ * \brief The statistics of a corpus, as a whole and for each speaker
+ */
+struct stats_table {
+    feature_stats global;
+    std::unordered_map<std::string, feature_stats> speakers;
+
+    bool store(const std::string& file) const;
+    bool load(const std::string& file);
+};
+
+/*!
+ * \brief Return the speaker of the given file, the path of its directory
+ */
+std::string speaker(const std::string& file);
+
+/*!
+ * \brief Compute the statistics of the given .feat files
+ */
+stats_table compute_stats(const std::vector<std::string>& files, std::size_t threads);
+
+/*!
+ * \brief Normalize the frames of the given file with the configured
+ * normalization mode.
+ */
+void normalize_frames(const std::string& file, frames_t& frames);
+
+/*!
+ * \brief Return a key identifying the normalization applied to the frames of
+ * the given file, 0 if it only depends on the file itself.
+ */
+std::uint64_t normalization_key(const std::string& file);
+
+/*!
+ * \brief Return a key identifying the content of the statistics file, 0 if
+ * the normalization mode does not use it.
+ */
+std::uint64_t stats_key();
+
+} //end of namespace ana
+
+#endif
@@ -0,0 +1,189 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_PAIRED_ITERATOR_HPP
+#define ANA_TEMPLATE_PAIRED_ITERATOR_HPP
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <mutex>
+
+#include "config.hpp"
+#include "data.hpp"
+#include "prefetcher.hpp"
+#include "telemetry.hpp"
+
+namespace ana {
+
+/*!
+ * \brief Loads each pair of samples and labels files once for a pair of
+ * paired_sample_iterator and paired_label_iterator.
+ *
+ * The last loaded utterances are kept so that the labels iterator can lag
+ * behind the samples iterator (by a big batch for instance) without reading
+ * the files again.
+ */
+struct paired_source {
+    static constexpr const std::size_t history_size = 32;
+
+    const ana::paired_files_t& files;
+
+    explicit paired_source(const ana::paired_files_t& files) : files(files) {}
+
+    paired_source(const paired_source& rhs) = delete;
+    paired_source& operator=(const paired_source& rhs) = delete;
+
+    std::size_t size() const {
+        return files.first.size();
+    }
+
+    std::shared_ptr<utterance_t> get(std::size_t i){
+        std::unique_lock<std::mutex> lock(mutex);
+
+        for(auto& entry : history){
+            if(entry.first == i){
+                return entry.second;
+            }
+        }
+
+        std::shared_ptr<utterance_t> utterance;
+
+        if(prefetch){
+            if(loader){
+                utterance = loader->pop(i);
+            }
+
+            //Restart the prefetcher when going forward or when all its utterances have been consumed (a new epoch)
+            if(!utterance && (!loader || i >= loader->next() || loader->next() >= size())){
+                auto& names = files;
+
+                auto read = [&names](std::size_t i, utterance_t& utterance){
+                    ana::read_utterance(names.first[i], names.second[i], utterance);
+                };
+
+                loader = std::make_shared<prefetcher<utterance_t>>(i, size(), read, prefetch_depth, prefetch_workers);
+                utterance = loader->pop(i);
+            }
+        }
+
+        if(!utterance){
+            utterance = std::make_shared<utterance_t>();
+            ana::read_utterance(files.first[i], files.second[i], *utterance);
+        }
+
+        history.emplace_back(i, utterance);
+
+        if(history.size() > history_size){
+            history.pop_front();
+        }
+
+        return utterance;
+    }
+
+private:
+    std::mutex mutex;
+    std::deque<std::pair<std::size_t, std::shared_ptr<utterance_t>>> history;
+    std::shared_ptr<prefetcher<utterance_t>> loader;
+};
+
+/*!
+ * \brief Iterator over the samples or the labels of the utterances of a
+ * paired_source.
+ *
+ * The utterance is shared with the other iterators of the same source and
+ * with the copies of the iterator, so copying an iterator is O(1). The
+ * windows are copied from the arena of the utterance in a buffer shared by
+ * the copies of the iterator, which is reused for each window.
+ */
+template<typename T>
+struct paired_iterator : std::iterator<std::input_iterator_tag, T> {
+    using values_t = utterance_values<T>;
+
+    std::shared_ptr<paired_source> source;
+
+    std::size_t current_file = 0;
+    std::shared_ptr<utterance_t> utterance;
+    std::size_t current = 0;
+
+    std::shared_ptr<T> buffer;
+
+    paired_iterator(std::shared_ptr<paired_source> source, std::size_t i = 0)
+            : source(source), current_file(i), buffer(values_t::buffer()) {
+        load();
+    }
+
+    paired_iterator(const paired_iterator& rhs) = default;
+    paired_iterator& operator=(const paired_iterator& rhs) = default;
+
+    std::size_t values() const {
+        return values_t::size(*utterance);
+    }
+
+    //Load the current file, skipping the files without any window
+    void load(){
+        phase_timer timer(phase::FILE_SWITCH);
+        count(counter::FILE_SWITCHES);
+
+        while(current_file < source->size()){
+            utterance = source->get(current_file);
+
+            if(values()){
+                break;
+            }
+
+            ++current_file;
+        }
+    }
+
+    bool operator==(const paired_iterator& rhs){
+        if(current_file == source->size() && current_file == rhs.current_file){
+            return true;
+        } else {
+            return current_file == rhs.current_file && current == rhs.current;
+        }
+    }
+
+    bool operator!=(const paired_iterator& rhs){
+        return !(*this == rhs);
+    }
+
+    T& operator*(){
+        return values_t::get(*utterance, current, buffer);
+    }
+
+    T* operator->(){
+        return &**this;
+    }
+
+    paired_iterator operator++(){
+        if(current == values() - 1){
+            ++current_file;
+            current = 0;
+
+            load();
+        } else {
+            ++current;
+        }
+
+        return *this;
+    }
+
+    paired_iterator operator++(int){
+        paired_iterator it = *this;
+        ++(*this);
+        return it;
+    }
+};
+
+using paired_sample_iterator = paired_iterator<ana::sample_t>;
+using paired_label_iterator = paired_iterator<ana::label_t>;
+
+} //end of namespace ana
+
+#endif
@@ -0,0 +1,154 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_PARALLEL_HPP
+#define ANA_TEMPLATE_PARALLEL_HPP
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+namespace ana {
+
+/*!
+ * \brief Return the number of threads to use for the given configuration,
+ * 0 meaning all the cores of the machine.
+ */
+inline std::size_t threads_count(std::size_t threads){
+    if(threads){
+        return threads;
+    }
+
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+/*!
+ * \brief Call functor(i) for each i in [0, n) with the given number of
+ * threads. The calling thread is one of the workers.
+ */
+template<typename Functor>
+void parallel_foreach_i(std::size_t n, std::size_t threads, Functor functor){
+    std::atomic<std::size_t> next(0);
+
+    auto work = [&next, n, &functor](){
+        std::size_t i;
+        while((i = next++) < n){
+            functor(i);
+        }
+    };
+
+    std::vector<std::thread> pool;
+
+    for(std::size_t t = 1; t < std::min(threads_count(threads), n); ++t){
+        pool.emplace_back(work);
+    }
+
+    work();
+
+    for(auto& thread : pool){
+        thread.join();
+    }
+}
+
+/*!
+ * \brief A fixed set of threads running the same task, for many short
+ * parallel steps without creating threads at each step.
+ *
+ * run(functor) calls functor(t) for each thread t in [0, size()) and waits
+ * for all of them. The calling thread is the worker 0.
+ */
+struct worker_pool {
+    explicit worker_pool(std::size_t threads) : threads(threads_count(threads)) {
+        for(std::size_t t = 1; t < this->threads; ++t){
+            pool.emplace_back([this, t](){ work(t); });
+        }
+    }
+
+    worker_pool(const worker_pool& rhs) = delete;
+    worker_pool& operator=(const worker_pool& rhs) = delete;
+
+    ~worker_pool(){
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stopped = true;
+        }
+
+        start.notify_all();
+
+        for(auto& thread : pool){
+            thread.join();
+        }
+    }
+
+    std::size_t size() const {
+        return threads;
+    }
+
+    template<typename Functor>
+    void run(Functor&& functor){
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            task = std::forward<Functor>(functor);
+            remaining = threads - 1;
+            ++generation;
+        }
+
+        start.notify_all();
+
+        task(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this](){ return remaining == 0; });
+    }
+
+private:
+    void work(std::size_t t){
+        std::size_t current = 0;
+
+        while(true){
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                start.wait(lock, [this, current](){ return generation != current || stopped; });
+
+                if(stopped){
+                    return;
+                }
+
+                current = generation;
+            }
+
+            task(t);
+
+            std::unique_lock<std::mutex> lock(mutex);
+
+            if(--remaining == 0){
+                done.notify_one();
+            }
+        }
+    }
+
+    const std::size_t threads;
+
+    std::vector<std::thread> pool;
+
+    std::mutex mutex;
+    std::condition_variable start;
+    std::condition_variable done;
+
+    std::function<void(std::size_t)> task;
+    std::size_t generation = 0;
+    std::size_t remaining = 0;
+    bool stopped = false;
+};
+
+} //end of namespace ana
+
+#endif
@@ -0,0 +1,209 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_PREFETCH_ITERATOR_HPP
+#define ANA_TEMPLATE_PREFETCH_ITERATOR_HPP
+
+#include <vector>
+#include <string>
+#include <memory>
+
+#include "config.hpp"
+#include "data.hpp"
+#include "settings.hpp"
+#include "prefetcher.hpp"
+#include "telemetry.hpp"
+
+namespace ana {
+
+/*!
+ * \brief A sample_iterator loading the next files in background threads.
+ *
+ * The copies of an iterator share the loaded windows and the prefetcher. A
+ * window is copied from the arena of its file in a buffer shared by the
+ * copies of the iterator, which is reused for each window.
+ */
+struct prefetch_sample_iterator : std::iterator<std::input_iterator_tag, ana::sample_t> {
+
+    const ana::paired_files_t& file_names;
+    const files_t& pt_files;
+    const bool pt;
+
+    std::size_t current_file = 0;
+    std::shared_ptr<window_arena> windows;
+    std::size_t current_sample = 0;
+
+    std::shared_ptr<prefetch_source<window_arena>> source;
+    std::shared_ptr<ana::sample_t> buffer;
+
+    prefetch_sample_iterator(const ana::paired_files_t& file_names, const files_t& pt_files, bool pt, std::size_t i = 0)
+            : file_names(file_names), pt_files(pt_files), pt(pt), current_file(i), buffer(std::make_shared<ana::sample_t>(settings().window_size())) {
+        auto& names = file_names;
+        auto& files = pt_files;
+
+        auto read = [&names, &files, pt](std::size_t i, window_arena& windows){
+            ana::read_windows(names, pt ? files[i] : names.first[i], windows, pt);
+        };
+
+        source = std::make_shared<prefetch_source<window_arena>>(end_file(), read);
+
+        load();
+    }
+
+    prefetch_sample_iterator(const prefetch_sample_iterator& rhs) = default;
+    prefetch_sample_iterator& operator=(const prefetch_sample_iterator& rhs) = default;
+
+    std::size_t end_file() const {
+        return pt ? pt_files.size() : file_names.first.size();
+    }
+
+    //Load the current file, skipping the files without any window
+    void load(){
+        phase_timer timer(phase::FILE_SWITCH);
+        count(counter::FILE_SWITCHES);
+
+        while(current_file < end_file()){
+            windows = source->get(current_file);
+
+            if(!windows->empty()){
+                break;
+            }
+
+            ++current_file;
+        }
+    }
+
+    bool operator==(const prefetch_sample_iterator& rhs){
+        if(current_file == end_file() && current_file == rhs.current_file){
+            return true;
+        } else {
+            return current_file == rhs.current_file && current_sample == rhs.current_sample;
+        }
+    }
+
+    bool operator!=(const prefetch_sample_iterator& rhs){
+        return !(*this == rhs);
+    }
+
+    ana::sample_t& operator*(){
+        windows->copy_window(current_sample, *buffer);
+        return *buffer;
+    }
+
+    ana::sample_t* operator->(){
+        return &**this;
+    }
+
+    prefetch_sample_iterator operator++(){
+        if(current_sample == windows->windows() - 1){
+            ++current_file;
+            current_sample = 0;
+
+            load();
+        } else {
+            ++current_sample;
+        }
+
+        return *this;
+    }
+
+    prefetch_sample_iterator operator++(int){
+        prefetch_sample_iterator it = *this;
+        ++(*this);
+        return it;
+    }
+};
+
+/*!
+ * \brief A label_iterator loading the next files in background threads.
+ */
+struct prefetch_label_iterator : std::iterator<std::input_iterator_tag, ana::label_t> {
+    using labels_t = std::vector<ana::label_t>;
+
+    const ana::paired_files_t& file_names;
+
+    std::size_t current_file = 0;
+    std::shared_ptr<labels_t> labels;
+    std::size_t current_label = 0;
+
+    std::shared_ptr<prefetch_source<labels_t>> source;
+
+    prefetch_label_iterator(const ana::paired_files_t& file_names, std::size_t i = 0)
+            : file_names(file_names), current_file(i) {
+        auto& names = file_names;
+
+        auto read = [&names](std::size_t i, labels_t& labels){
+            ana::read_labels(names.second[i], labels);
+        };
+
+        source = std::make_shared<prefetch_source<labels_t>>(file_names.second.size(), read);
+
+        load();
+    }
+
+    prefetch_label_iterator(const prefetch_label_iterator& rhs) = default;
+    prefetch_label_iterator& operator=(const prefetch_label_iterator& rhs) = default;
+
+    //Load the current file, skipping the files without any window
+    void load(){
+        phase_timer timer(phase::FILE_SWITCH);
+        count(counter::FILE_SWITCHES);
+
+        while(current_file < file_names.second.size()){
+            labels = source->get(current_file);
+
+            if(!labels->empty()){
+                break;
+            }
+
+            ++current_file;
+        }
+    }
+
+    bool operator==(const prefetch_label_iterator& rhs){
+        if(current_file == file_names.second.size() && current_file == rhs.current_file){
+            return true;
+        } else {
+            return current_file == rhs.current_file && current_label == rhs.current_label;
+        }
+    }
+
+    bool operator!=(const prefetch_label_iterator& rhs){
+        return !(*this == rhs);
+    }
+
+    ana::label_t& operator*(){
+        return (*labels)[current_label];
+    }
+
+    ana::label_t* operator->(){
+        return &(*labels)[current_label];
+    }
+
+    prefetch_label_iterator operator++(){
+        if(current_label == labels->size() - 1){
+            ++current_file;
+            current_label = 0;
+
+            load();
+        } else {
+            ++current_label;
+        }
+
+        return *this;
+    }
+
+    prefetch_label_iterator operator++(int){
+        prefetch_label_iterator it = *this;
+        ++(*this);
+        return it;
+    }
+};
+
+} //end of namespace ana
+
+#endif
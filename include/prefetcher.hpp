@@ -0,0 +1,249 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_PREFETCHER_HPP
+#define ANA_TEMPLATE_PREFETCHER_HPP
+
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include <iostream>
+#include <algorithm>
+#include <deque>
+
+#include "config.hpp"
+
+namespace ana {
+
+/*!
+ * \brief Counters describing how long the training thread waited for the
+ * prefetchers.
+ */
+struct prefetch_stats_t {
+    std::atomic<std::size_t> files;   ///< The number of files consumed
+    std::atomic<std::size_t> waits;   ///< The number of files that were not ready when needed
+    std::atomic<std::size_t> wait_us; ///< The total waiting time, in microseconds
+
+    prefetch_stats_t() : files(0), waits(0), wait_us(0) {}
+
+    void reset(){
+        files = 0;
+        waits = 0;
+        wait_us = 0;
+    }
+
+    void print(const std::string& phase){
+        std::cout << phase << ": waited " << wait_us / 1000 << "ms for " << waits << " of " << files << " files" << std::endl;
+    }
+};
+
+inline prefetch_stats_t& prefetch_stats(){
+    static prefetch_stats_t stats;
+    return stats;
+}
+
+/*!
+ * \brief Load the elements [first, last) in order with a pool of threads,
+ * keeping at most depth elements loaded ahead of the consumer.
+ */
+template<typename T>
+struct prefetcher {
+    using loader_t = std::function<void(std::size_t, T&)>;
+
+    prefetcher(std::size_t first, std::size_t last, loader_t loader, std::size_t depth, std::size_t workers)
+            : loader(loader), last(last), depth(std::max(depth, std::size_t(1))), next_load(first), next_pop(first) {
+        for(std::size_t i = 0; i < std::max(workers, std::size_t(1)); ++i){
+            threads.emplace_back([this](){ work(); });
+        }
+    }
+
+    prefetcher(const prefetcher& rhs) = delete;
+    prefetcher& operator=(const prefetcher& rhs) = delete;
+
+    ~prefetcher(){
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stop = true;
+        }
+
+        cv_load.notify_all();
+
+        for(auto& thread : threads){
+            thread.join();
+        }
+    }
+
+    /*!
+     * \brief Return the index of the element that the next pop() returns
+     */
+    std::size_t next(){
+        std::unique_lock<std::mutex> lock(mutex);
+        return next_pop;
+    }
+
+    /*!
+     * \brief Wait for the element i and return it.
+     *
+     * \return the element, or nullptr if the next element is not i
+     */
+    std::shared_ptr<T> pop(std::size_t i){
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if(i != next_pop || i >= last){
+            return nullptr;
+        }
+
+        auto& stats = prefetch_stats();
+        ++stats.files;
+
+        if(!ready.count(i)){
+            ++stats.waits;
+
+            auto start = std::chrono::steady_clock::now();
+
+            cv_ready.wait(lock, [this, i](){ return ready.count(i) > 0; });
+
+            auto end = std::chrono::steady_clock::now();
+            stats.wait_us += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        }
+
+        auto element = ready[i];
+        ready.erase(i);
+        ++next_pop;
+
+        lock.unlock();
+        cv_load.notify_one();
+
+        return element;
+    }
+
+private:
+    void work(){
+        while(true){
+            std::size_t i;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+
+                cv_load.wait(lock, [this](){ return stop || (next_load < last && next_load < next_pop + depth); });
+
+                if(stop){
+                    return;
+                }
+
+                i = next_load++;
+            }
+
+            auto element = std::make_shared<T>();
+            loader(i, *element);
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready[i] = element;
+            }
+
+            cv_ready.notify_all();
+        }
+    }
+
+    loader_t loader;
+
+    const std::size_t last;
+    const std::size_t depth;
+
+    std::size_t next_load;
+    std::size_t next_pop;
+    bool stop = false;
+
+    std::map<std::size_t, std::shared_ptr<T>> ready;
+
+    std::mutex mutex;
+    std::condition_variable cv_load;
+    std::condition_variable cv_ready;
+
+    std::vector<std::thread> threads;
+};
+
+/*!
+ * \brief The elements [0, size) loaded by a prefetcher shared by all the
+ * copies of an iterator.
+ *
+ * The copies of an iterator are not all at the same position, dll copies the
+ * iterators at the start of the batches. The last returned elements are kept
+ * so that the copies lagging behind do not read them again, nor start another
+ * prefetcher.
+ */
+template<typename T>
+struct prefetch_source {
+    static constexpr const std::size_t history_size = 32;
+
+    using loader_t = typename prefetcher<T>::loader_t;
+
+    prefetch_source(std::size_t size, loader_t loader) : loader(loader), elements(size) {}
+
+    prefetch_source(const prefetch_source& rhs) = delete;
+    prefetch_source& operator=(const prefetch_source& rhs) = delete;
+
+    std::size_t size() const {
+        return elements;
+    }
+
+    std::shared_ptr<T> get(std::size_t i){
+        std::unique_lock<std::mutex> lock(mutex);
+
+        for(auto& entry : history){
+            if(entry.first == i){
+                return entry.second;
+            }
+        }
+
+        std::shared_ptr<T> element;
+
+        if(current){
+            element = current->pop(i);
+        }
+
+        //Restart the prefetcher when going forward or when all its elements have been consumed (a new epoch)
+        if(!element && (!current || i >= current->next() || current->next() >= elements)){
+            current.reset();
+            current = std::make_unique<prefetcher<T>>(i, elements, loader, prefetch_depth, prefetch_workers);
+            element = current->pop(i);
+        }
+
+        if(!element){
+            element = std::make_shared<T>();
+            loader(i, *element);
+        }
+
+        history.emplace_back(i, element);
+
+        if(history.size() > history_size){
+            history.pop_front();
+        }
+
+        return element;
+    }
+
+private:
+    loader_t loader;
+    const std::size_t elements;
+
+    std::mutex mutex;
+    std::deque<std::pair<std::size_t, std::shared_ptr<T>>> history;
+    std::unique_ptr<prefetcher<T>> current;
+};
+
+} //end of namespace ana
+
+#endif
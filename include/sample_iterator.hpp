@@ -11,28 +11,37 @@
 #include <vector>
 #include <string>
 #include <mutex>
+#include <memory>
 
 #include "data.hpp"
+#include "settings.hpp"
+#include "telemetry.hpp"
 
 namespace ana {
 
+/*!
+ * \brief Iterator over the windows of the files, one file being read at a
+ * time.
+ *
+ * The windows of the current file stay in an arena. A window is copied in a
+ * buffer shared by the copies of the iterator when it is dereferenced, the
+ * buffer being reused for each window.
+ */
 struct sample_iterator : std::iterator<std::input_iterator_tag, ana::sample_t> {
     const ana::paired_files_t& file_names;
     const files_t& pt_files;
     const bool pt;
 
     std::size_t current_file = 0;
-    std::vector<ana::sample_t> samples;
+    std::shared_ptr<window_arena> windows;
     std::size_t current_sample = 0;
 
+    std::shared_ptr<ana::sample_t> buffer;
+
     sample_iterator(const ana::paired_files_t& file_names, const files_t& pt_files, bool pt, std::size_t i = 0)
-            : file_names(file_names), pt_files(pt_files), pt(pt), current_file(i) {
+            : file_names(file_names), pt_files(pt_files), pt(pt), current_file(i), buffer(std::make_shared<ana::sample_t>(settings().window_size())) {
         if(current_file < end_file()){
-            if(pt){
-                read_samples(pt, file_names, pt_files[current_file], samples);
-            } else {
-                read_samples(pt, file_names, file_names.first[current_file], samples);
-            }
+            load();
         }
     }
 
@@ -43,9 +52,13 @@ struct sample_iterator : std::iterator<std::input_iterator_tag, ana::sample_t> {
     sample_iterator(const sample_iterator& rhs) = default;
     sample_iterator& operator=(const sample_iterator& rhs) = default;
 
-    static void read_samples(bool pt, const ana::paired_files_t& file_names, const std::string& name, std::vector<ana::sample_t>& samples){
-        samples.clear();
-        ana::read_samples(file_names, name, samples, pt);
+    //Read the windows of the current file, the arena is reused if no copy of the iterator still uses it
+    void load(){
+        if(!windows || windows.use_count() > 1){
+            windows = std::make_shared<window_arena>();
+        }
+
+        ana::read_windows(file_names, pt ? pt_files[current_file] : file_names.first[current_file], *windows, pt);
     }
 
     bool operator==(const sample_iterator& rhs){
@@ -61,24 +74,24 @@ struct sample_iterator : std::iterator<std::input_iterator_tag, ana::sample_t> {
     }
 
     ana::sample_t& operator*(){
-        return samples[current_sample];
+        windows->copy_window(current_sample, *buffer);
+        return *buffer;
     }
 
     ana::sample_t* operator->(){
-        return &samples[current_sample];
+        return &**this;
     }
 
     sample_iterator operator++(){
-        if(current_sample == samples.size() - 1){
+        if(current_sample == windows->windows() - 1){
             ++current_file;
             current_sample = 0;
 
             if(current_file < end_file()){
-                if(pt){
-                    read_samples(pt, file_names, pt_files[current_file], samples);
-                } else {
-                    read_samples(pt, file_names, file_names.first[current_file], samples);
-                }
+                phase_timer timer(phase::FILE_SWITCH);
+                count(counter::FILE_SWITCHES);
+
+                load();
             }
         } else {
             ++current_sample;
@@ -0,0 +1,65 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_SCAN_HPP
+#define ANA_TEMPLATE_SCAN_HPP
+
+#include <vector>
+#include <string>
+
+#include "config.hpp"
+#include "data.hpp"
+
+namespace ana {
+
+/*!
+ * \brief The number of windows of the data files, counted from their lines
+ * without parsing them.
+ */
+struct data_scan {
+    std::vector<std::size_t> pt_windows;    ///< The windows of each pretraining file
+    std::vector<std::size_t> ft_windows;    ///< The windows of each fine-tuning samples file
+    std::vector<std::size_t> ft_labels;     ///< The labels of each fine-tuning labels file
+
+    /*!
+     * \brief The memory of the pretraining windows read at once
+     */
+    std::size_t pt_bytes() const;
+
+    /*!
+     * \brief The memory of the fine-tuning windows and labels read at once
+     */
+    std::size_t ft_bytes() const;
+};
+
+/*!
+ * \brief Return the number of lines of the given file, the last one being
+ * counted even without newline
+ */
+std::size_t count_lines(const std::string& file);
+
+/*!
+ * \brief Count the windows of the pretraining files and of the fine-tuning
+ * files with the given number of threads
+ */
+data_scan scan_data(const files_t& pt_files, const paired_files_t& ft_files, std::size_t threads);
+
+/*!
+ * \brief Return the memory currently available on the machine, in bytes
+ */
+std::size_t available_memory();
+
+/*!
+ * \brief Choose between the eager and the lazy loading of the pretraining and
+ * of the fine-tuning, from their memory and eager_memory_bytes, and set
+ * settings().lazy_pt and settings().lazy_ft.
+ */
+void choose_loading(const data_scan& scan);
+
+} //end of namespace ana
+
+#endif
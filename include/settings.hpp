@@ -0,0 +1,69 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_SETTINGS_HPP
+#define ANA_TEMPLATE_SETTINGS_HPP
+
+#include <string>
+
+#include "config.hpp"
+
+namespace ana {
+
+/*!
+ * \brief The settings that can be changed without rebuilding.
+ *
+ * The defaults are the values of config.hpp. They can be overridden by a
+ * settings file (--config=file) and by command line options (--key=value).
+ * Settings files contain one key=value per line, # starts a comment.
+ *
+ * The settings must not be changed once the data is being read.
+ */
+struct settings_t {
+    std::size_t n = N;               ///< The number of frames of a window
+    std::size_t features = Features; ///< The number of features of a frame
+    std::size_t stride = Stride;     ///< The number of frames between two windows
+
+    bool lazy_pt = ::lazy_pt;
+    bool lazy_ft = ::lazy_ft;
+
+    std::size_t jobs = feature_jobs; ///< The number of threads of each stage of the feature generation
+
+    /*!
+     * \brief The number of values of a window
+     */
+    std::size_t window_size() const {
+        return n * features;
+    }
+
+    /*!
+     * \brief Set the given setting from a "key=value" string
+     * \return false if the key is unknown or the value invalid
+     */
+    bool set(const std::string& setting);
+
+    /*!
+     * \brief Set the settings of the given file
+     * \return false if the file cannot be read or contains an invalid setting
+     */
+    bool load(const std::string& file);
+
+    /*!
+     * \brief Set the settings from the options of the command line
+     * \return false if an option is invalid
+     */
+    bool parse(int argc, char* argv[], int first);
+};
+
+/*!
+ * \brief The settings of the program
+ */
+settings_t& settings();
+
+} //end of namespace ana
+
+#endif
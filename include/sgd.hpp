@@ -0,0 +1,267 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_SGD_HPP
+#define ANA_TEMPLATE_SGD_HPP
+
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <type_traits>
+
+#include "dll/unit_type.hpp"
+
+#include "cpp_utils/data.hpp"
+
+#include "config.hpp"
+#include "checkpoint.hpp"
+#include "parallel.hpp"
+#include "bounded_queue.hpp"
+
+namespace ana {
+
+/*!
+ * \brief A layer of the network trained by the SGD: a visible x hidden
+ * row-major weight matrix and the hidden biases
+ */
+struct sgd_layer {
+    float* w;
+    float* b;
+    std::size_t visible;
+    std::size_t hidden;
+    dll::unit_type unit;
+};
+
+/*!
+ * \brief The parameters of an update, as in the SGD of DLL
+ */
+struct sgd_parameters {
+    float learning_rate;
+    float momentum;
+    float weight_cost;  ///< The L2 weight decay
+};
+
+/*!
+ * \brief Apply the momentum and weight decay update of the gradients of rows
+ * windows to the values [first, last), as in DLL:
+ * inc = momentum * inc + learning_rate / rows * (grad - cost * value)
+ */
+inline void momentum_update(std::size_t first, std::size_t last, const float* grad, float* inc, float* value, float cost, std::size_t rows, float learning_rate, float momentum){
+    auto eps = learning_rate / rows;
+
+    for(std::size_t i = first; i < last; ++i){
+        inc[i] = momentum * inc[i] + eps * (grad[i] - cost * value[i]);
+        value[i] += inc[i];
+    }
+}
+
+/*!
+ * \brief A mini-batch of windows, stored as a row-major matrix, and their labels
+ */
+struct sgd_batch {
+    std::vector<float> inputs;
+    std::vector<std::size_t> labels;
+};
+
+/*!
+ * \brief Data-parallel SGD fine-tuning of the layers of a network.
+ *
+ * In the synchronous mode, each mini-batch is split between the threads,
+ * which compute the gradients of their rows in their own buffers. The
+ * gradients are then reduced, each thread summing a part of the weights, and
+ * the momentum and weight decay update is the same as with a single thread.
+ *
+ * In the hogwild mode, each thread trains on its own mini-batches and updates
+ * the shared weights without any synchronization, with its own momentum.
+ *
+ * The trainer counts its epochs and keeps its momentum increments, a
+ * fine-tuning in several parts uses the same trainer for all of them, and its
+ * state() is saved in the checkpoints to restore() it on resume.
+ */
+struct sgd_trainer {
+    sgd_trainer(std::vector<sgd_layer> layers, std::size_t threads);
+
+    std::size_t threads() const {
+        return pool.size();
+    }
+
+    /*!
+     * \brief Train on one mini-batch, split between the threads
+     * \return the number of windows of the batch wrongly classified before the update
+     */
+    std::size_t step(const sgd_batch& batch, const sgd_parameters& parameters);
+
+    /*!
+     * \brief Return the number of epochs trained
+     */
+    std::size_t epochs() const {
+        return trained_epochs;
+    }
+
+    /*!
+     * \brief Train on all the mini-batches of the queue, until it is closed
+     * \return the number of windows wrongly classified before their update
+     */
+    std::size_t epoch(bounded_queue<sgd_batch>& batches, const sgd_parameters& parameters, bool hogwild);
+
+    /*!
+     * \brief Return the epochs and the momentum increments of the trainer,
+     * the shared ones followed by the ones of the threads in the hogwild mode
+     */
+    trainer_state state() const;
+
+    /*!
+     * \brief Continue the training from the given state
+     * \return false if the state does not match the layers or the threads
+     */
+    bool restore(const trainer_state& state);
+
+private:
+    //The buffers of one thread
+    struct worker_t {
+        std::vector<std::vector<float>> activations;
+        std::vector<std::vector<float>> deltas;
+        std::vector<std::vector<float>> w_grads;
+        std::vector<std::vector<float>> b_grads;
+
+        //The momentum of the thread in the hogwild mode
+        std::vector<std::vector<float>> w_incs;
+        std::vector<std::vector<float>> b_incs;
+
+        std::size_t errors = 0;
+    };
+
+    std::size_t gradients(worker_t& worker, const float* inputs, const std::size_t* labels, std::size_t rows);
+
+    std::vector<sgd_layer> layers;
+    std::vector<worker_t> workers;
+
+    std::vector<std::vector<float>> w_incs;
+    std::vector<std::vector<float>> b_incs;
+
+    std::size_t trained_epochs = 0;
+
+    worker_pool pool;
+};
+
+namespace detail {
+
+template<std::size_t I, typename DBN, cpp_enable_if((I == DBN::layers))>
+void sgd_layers(DBN&, std::vector<sgd_layer>&){
+    //Done
+}
+
+template<std::size_t I, typename DBN, cpp_enable_if((I < DBN::layers))>
+void sgd_layers(DBN& dbn, std::vector<sgd_layer>& layers){
+    auto& rbm = dbn.template layer_get<I>();
+
+    using rbm_t = typename std::decay<decltype(rbm)>::type;
+
+    static_assert(std::is_same<typename rbm_t::weight, float>::value, "The parallel SGD only supports float weights");
+
+    layers.push_back({rbm.w.memory_start(), rbm.b.memory_start(), rbm_t::num_visible, rbm_t::num_hidden, rbm_t::hidden_unit});
+
+    sgd_layers<I + 1>(dbn, layers);
+}
+
+} //end of namespace detail
+
+/*!
+ * \brief Return the layers of the parallel SGD for the given DBN
+ */
+template<typename DBN>
+std::vector<sgd_layer> make_sgd_layers(DBN& dbn){
+    std::vector<sgd_layer> layers;
+    detail::sgd_layers<0>(dbn, layers);
+    return layers;
+}
+
+/*!
+ * \brief Fine-tune the DBN for epochs more epochs with the given trainer of its
+ * layers, with mini-batches of sgd_batch_size windows. The windows and the
+ * labels are read by a separate thread from the given iterators.
+ *
+ * The momentum schedule of the DBN continues from the epochs already trained
+ * by the trainer.
+ *
+ * \return the classification error of the last epoch
+ */
+template<typename DBN, typename Iterator, typename LIterator>
+double parallel_fine_tune(DBN& dbn, sgd_trainer& sgd, Iterator first, Iterator last, LIterator lfirst, LIterator llast, std::size_t epochs){
+    double error = 0.0;
+
+    for(std::size_t e = 0; e < epochs; ++e){
+        auto start = std::chrono::steady_clock::now();
+
+        auto epoch = sgd.epochs();
+
+        dbn.momentum = epoch < dbn.final_momentum_epoch ? dbn.initial_momentum : dbn.final_momentum;
+
+        sgd_parameters parameters{float(dbn.learning_rate), float(dbn.momentum), float(dbn.weight_cost)};
+
+        bounded_queue<sgd_batch> batches(2 * sgd.threads());
+
+        std::size_t windows = 0;
+
+        std::thread reader([&](){
+            sgd_batch batch;
+
+            auto it = first;
+            auto lit = lfirst;
+
+            for(; it != last && lit != llast; ++it, ++lit){
+                batch.inputs.insert(batch.inputs.end(), it->begin(), it->end());
+                batch.labels.push_back(*lit);
+
+                if(batch.labels.size() == sgd_batch_size){
+                    windows += batch.labels.size();
+                    batches.push(std::move(batch));
+                    batch = sgd_batch();
+                }
+            }
+
+            if(!batch.labels.empty()){
+                windows += batch.labels.size();
+                batches.push(std::move(batch));
+            }
+
+            batches.close();
+        });
+
+        auto errors = sgd.epoch(batches, parameters, hogwild_sgd);
+
+        reader.join();
+
+        error = windows ? errors / double(windows) : 0.0;
+
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "epoch " << epoch << " - Classification error: " << error << " Time " << ms << "ms" << std::endl;
+    }
+
+    return error;
+}
+
+/*!
+ * \brief Fine-tune the DBN with the parallel SGD for epochs epochs, with a new
+ * trainer.
+ *
+ * \return the classification error of the last epoch
+ */
+template<typename DBN, typename Iterator, typename LIterator>
+double parallel_fine_tune(DBN& dbn, Iterator first, Iterator last, LIterator lfirst, LIterator llast, std::size_t epochs){
+    sgd_trainer sgd(make_sgd_layers(dbn), sgd_threads);
+
+    std::cout << "Parallel SGD with " << sgd.threads() << " threads" << (hogwild_sgd ? " (hogwild)" : "") << std::endl;
+
+    return parallel_fine_tune(dbn, sgd, first, last, lfirst, llast, epochs);
+}
+
+} //end of namespace ana
+
+#endif
@@ -0,0 +1,195 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_SHARD_HPP
+#define ANA_TEMPLATE_SHARD_HPP
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include "config.hpp"
+#include "data.hpp"
+
+namespace ana {
+
+/*!
+ * \brief Layout of the header of a shard file.
+ *
+ * A shard file contains the header, followed by the normalized frames of all
+ * its utterances (aligned on 64 bytes), the utterance table and the window
+ * table. A window is stored as the index of its first frame, its N frames
+ * being contiguous in the frames array.
+ */
+struct shard_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t n;
+    std::uint32_t stride;
+    std::uint32_t features;
+    std::uint64_t utterances;
+    std::uint64_t frames;
+    std::uint64_t windows;
+    std::uint64_t frames_offset;
+    std::uint64_t utterances_offset;
+    std::uint64_t windows_offset;
+    std::uint64_t files_hash;   ///< The hash of the list of the samples files and of the labels files
+    std::uint64_t normalization; ///< The normalization_mode of the frames
+    std::uint64_t stats_hash;   ///< The hash of the statistics file used by the normalization, 0 if none
+};
+
+struct shard_utterance {
+    std::uint64_t first_frame;
+    std::uint64_t frames;
+    std::uint64_t first_window;
+    std::uint64_t windows;
+};
+
+/*!
+ * \brief Pack the normalized frames of the given files in one shard file.
+ *
+ * If pt is false, the files are the fine-tuning files and the <sil> windows
+ * are dropped if drop_sil_windows is set.
+ */
+bool write_shard(const paired_files_t& files, const files_t& samples_files, bool pt, const std::string& shard_file);
+
+/*!
+ * \brief A read-only memory mapping of a shard file.
+ *
+ * The shard is only valid if it was built from the given samples files and
+ * labels files (no labels files for the pretraining), in the same order, and
+ * normalized with the same mode and statistics.
+ */
+struct shard_t {
+    shard_t(const std::string& shard_file, const files_t& samples_files, const files_t& labels_files);
+    ~shard_t();
+
+    shard_t(const shard_t& rhs) = delete;
+    shard_t& operator=(const shard_t& rhs) = delete;
+
+    bool valid() const {
+        return header != nullptr;
+    }
+
+    std::size_t utterances() const {
+        return valid() ? header->utterances : 0;
+    }
+
+    std::size_t windows() const {
+        return valid() ? header->windows : 0;
+    }
+
+    const shard_utterance& utterance(std::size_t i) const {
+        return utterances_table[i];
+    }
+
+    /*!
+     * \brief The number of values of each window
+     */
+    std::size_t window_size() const {
+        return valid() ? header->n * header->features : 0;
+    }
+
+    const float* window(std::size_t i) const {
+        return frames + windows_table[i] * header->features;
+    }
+
+private:
+    void* mapping = nullptr;
+    std::size_t mapping_size = 0;
+
+    const shard_header* header = nullptr;
+    const float* frames = nullptr;
+    const shard_utterance* utterances_table = nullptr;
+    const std::uint64_t* windows_table = nullptr;
+};
+
+/*!
+ * \brief A view on one window of a shard, pointing directly in the mapped frames
+ */
+struct window_view {
+    const float* first;
+    std::size_t length;
+
+    std::size_t size() const {
+        return length;
+    }
+
+    const float* begin() const {
+        return first;
+    }
+
+    const float* end() const {
+        return first + length;
+    }
+
+    float operator[](std::size_t i) const {
+        return first[i];
+    }
+};
+
+/*!
+ * \brief Input iterator over the windows of a shard.
+ *
+ * view() gives a zero-copy view of the current window. Since the DBN needs
+ * ETL containers, dereferencing the iterator copies the current window in a
+ * buffer shared by the copies of the iterator, which is reused for each
+ * window.
+ */
+struct shard_iterator : std::iterator<std::input_iterator_tag, ana::sample_t> {
+    const shard_t& shard;
+
+    std::size_t current_window = 0;
+
+    std::shared_ptr<ana::sample_t> buffer;
+
+    shard_iterator(const shard_t& shard, std::size_t i = 0)
+            : shard(shard), current_window(i), buffer(std::make_shared<ana::sample_t>(shard.window_size())) {
+        //Nothing else to init
+    }
+
+    shard_iterator(const shard_iterator& rhs) = default;
+    shard_iterator& operator=(const shard_iterator& rhs) = default;
+
+    bool operator==(const shard_iterator& rhs){
+        return current_window == rhs.current_window;
+    }
+
+    bool operator!=(const shard_iterator& rhs){
+        return !(*this == rhs);
+    }
+
+    window_view view() const {
+        return {shard.window(current_window), shard.window_size()};
+    }
+
+    ana::sample_t& operator*(){
+        auto window = shard.window(current_window);
+        std::copy(window, window + shard.window_size(), buffer->begin());
+        return *buffer;
+    }
+
+    ana::sample_t* operator->(){
+        return &**this;
+    }
+
+    shard_iterator operator++(){
+        ++current_window;
+        return *this;
+    }
+
+    shard_iterator operator++(int){
+        shard_iterator it = *this;
+        ++(*this);
+        return it;
+    }
+};
+
+} //end of namespace ana
+
+#endif
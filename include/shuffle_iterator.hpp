@@ -0,0 +1,335 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_SHUFFLE_ITERATOR_HPP
+#define ANA_TEMPLATE_SHUFFLE_ITERATOR_HPP
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <algorithm>
+#include <type_traits>
+
+#include "config.hpp"
+#include "data.hpp"
+#include "prefetcher.hpp"
+#include "telemetry.hpp"
+
+namespace ana {
+
+/*!
+ * \brief Loads the utterances of the shuffled iterators.
+ *
+ * Each epoch, the files are visited in a different order, drawn from the seed
+ * and the epoch. The iterators of the samples and of the labels draw the same
+ * windows in the same order, the utterances they read are shared.
+ */
+struct shuffle_source {
+    static constexpr const std::size_t history_size = 32;
+
+    const std::size_t seed;
+
+    /*!
+     * \brief Create a source over the given files. If labels_files is empty,
+     * only the samples are read (pretraining). The epochs are numbered from
+     * first_epoch, to resume a training.
+     */
+    shuffle_source(const files_t& samples_files, const files_t& labels_files, std::size_t seed, std::size_t first_epoch = 0)
+            : seed(seed), samples_files(samples_files), labels_files(labels_files), epochs{first_epoch, first_epoch} {}
+
+    shuffle_source(const shuffle_source& rhs) = delete;
+    shuffle_source& operator=(const shuffle_source& rhs) = delete;
+
+    std::size_t size() const {
+        return samples_files.size();
+    }
+
+    /*!
+     * \brief Return the current epoch of the given iterator role
+     */
+    std::size_t epoch(std::size_t role){
+        std::unique_lock<std::mutex> lock(mutex);
+        return epochs[role];
+    }
+
+    /*!
+     * \brief Mark the given epoch of the iterator role as completed, the next
+     * iterators of the role start the next epoch. The other copies reaching
+     * the end of the same epoch do not change the epoch again.
+     */
+    void finish_epoch(std::size_t role, std::size_t epoch){
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if(epochs[role] == epoch){
+            ++epochs[role];
+        }
+    }
+
+    /*!
+     * \brief Return the order of the files for the given epoch
+     */
+    std::shared_ptr<const std::vector<std::size_t>> order(std::size_t epoch){
+        std::unique_lock<std::mutex> lock(mutex);
+
+        auto& permutation = orders[epoch];
+
+        if(!permutation){
+            auto files = std::make_shared<std::vector<std::size_t>>(size());
+
+            for(std::size_t i = 0; i < size(); ++i){
+                (*files)[i] = i;
+            }
+
+            std::seed_seq sequence{seed, epoch, std::size_t(0)};
+            std::mt19937 generator(sequence);
+            std::shuffle(files->begin(), files->end(), generator);
+
+            permutation = files;
+
+            //Only the orders of the current epochs are needed
+            while(orders.size() > 2){
+                orders.erase(orders.begin());
+            }
+        }
+
+        return permutation;
+    }
+
+    /*!
+     * \brief Return the utterance at the position p of the order of the epoch
+     */
+    std::shared_ptr<utterance_t> get(std::size_t epoch, std::size_t p){
+        auto files = order(epoch);
+        auto i = (*files)[p];
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        for(auto& entry : history){
+            if(entry.first == i){
+                return entry.second;
+            }
+        }
+
+        std::shared_ptr<utterance_t> utterance;
+
+        if(prefetch){
+            if(loader && loader_epoch == epoch){
+                utterance = loader->pop(p);
+            }
+
+            //Only restart the prefetcher when going forward
+            if(!utterance && (!loader || loader_epoch != epoch || p >= loader->next())){
+                auto read = [this, files](std::size_t p, utterance_t& utterance){
+                    load((*files)[p], utterance);
+                };
+
+                loader = std::make_shared<prefetcher<utterance_t>>(p, size(), read, prefetch_depth, prefetch_workers);
+                loader_epoch = epoch;
+                utterance = loader->pop(p);
+            }
+        }
+
+        if(!utterance){
+            utterance = std::make_shared<utterance_t>();
+            load(i, *utterance);
+        }
+
+        history.emplace_back(i, utterance);
+
+        if(history.size() > history_size){
+            history.pop_front();
+        }
+
+        return utterance;
+    }
+
+private:
+    void load(std::size_t i, utterance_t& utterance) const {
+        if(labels_files.empty()){
+            utterance.frames = ana::read_windows({}, samples_files[i], utterance.windows, true);
+        } else {
+            ana::read_utterance(samples_files[i], labels_files[i], utterance);
+        }
+    }
+
+    const files_t samples_files;
+    const files_t labels_files;
+
+    std::mutex mutex;
+    std::size_t epochs[2];
+    std::map<std::size_t, std::shared_ptr<const std::vector<std::size_t>>> orders;
+    std::deque<std::pair<std::size_t, std::shared_ptr<utterance_t>>> history;
+    std::shared_ptr<prefetcher<utterance_t>> loader;
+    std::size_t loader_epoch = 0;
+};
+
+/*!
+ * \brief Iterator over the shuffled samples or labels of a shuffle_source.
+ *
+ * The windows of the next shuffle_files files are interleaved randomly and
+ * go through a buffer of shuffle_buffer windows, from which each window is
+ * drawn at random.
+ *
+ * When it is first used, an iterator takes the current epoch of its role
+ * (samples or labels). The epoch of a role only changes once an iterator of
+ * the role has drawn all the windows of the epoch. The copies of the begin
+ * iterator that are only compared or dereferenced by the trainer therefore
+ * draw the same windows as the copy used for the epoch. All the random draws
+ * depend only on the seed and on the epoch, and each utterance has as many
+ * samples as labels, so the samples and the labels iterators stay aligned.
+ *
+ * The windows are copied from the arena of their utterance in a value shared
+ * by the copies of the iterator, which is reused for each window.
+ */
+template<typename T>
+struct shuffle_iterator : std::iterator<std::input_iterator_tag, T> {
+    using values_t = utterance_values<T>;
+
+    std::shared_ptr<shuffle_source> source;
+
+    shuffle_iterator(std::shared_ptr<shuffle_source> source, bool end = false)
+            : source(source), value(values_t::buffer()), end(end) {}
+
+    shuffle_iterator(const shuffle_iterator& rhs) = default;
+    shuffle_iterator& operator=(const shuffle_iterator& rhs) = default;
+
+    bool operator==(const shuffle_iterator& rhs){
+        //A copy of the begin iterator that has not been used yet is never at the end
+        return done() == (rhs.end || (rhs.started && !rhs.current.first));
+    }
+
+    bool operator!=(const shuffle_iterator& rhs){
+        return !(*this == rhs);
+    }
+
+    T& operator*(){
+        start();
+        return values_t::get(*current.first, current.second, value);
+    }
+
+    T* operator->(){
+        return &**this;
+    }
+
+    shuffle_iterator& operator++(){
+        start();
+        draw();
+        return *this;
+    }
+
+    shuffle_iterator operator++(int){
+        shuffle_iterator it = *this;
+        ++(*this);
+        return it;
+    }
+
+private:
+    using window_t = std::pair<std::shared_ptr<utterance_t>, std::size_t>;
+
+    static constexpr const std::size_t role = std::is_same<T, ana::sample_t>::value ? 0 : 1;
+
+    bool done(){
+        if(end){
+            return true;
+        }
+
+        start();
+
+        return !current.first;
+    }
+
+    void start(){
+        if(started){
+            return;
+        }
+
+        started = true;
+
+        epoch = source->epoch(role);
+
+        std::seed_seq sequence{source->seed, epoch, std::size_t(1)};
+        generator.seed(sequence);
+
+        window_t window;
+        while(buffer.size() < shuffle_buffer && next_window(window)){
+            buffer.push_back(window);
+        }
+
+        draw();
+    }
+
+    //Take the next window of the open files, opening new files if necessary
+    bool next_window(window_t& window){
+        while(open.size() < shuffle_files && next_file < source->size()){
+            phase_timer timer(phase::FILE_SWITCH);
+            count(counter::FILE_SWITCHES);
+
+            auto utterance = source->get(epoch, next_file++);
+
+            if(values_t::size(*utterance)){
+                open.emplace_back(utterance, 0);
+            }
+        }
+
+        if(open.empty()){
+            return false;
+        }
+
+        auto i = generator() % open.size();
+
+        window = open[i];
+
+        if(++open[i].second == values_t::size(*open[i].first)){
+            open[i] = open.back();
+            open.pop_back();
+        }
+
+        return true;
+    }
+
+    //Draw the current window from the buffer and replace it by the next one
+    void draw(){
+        if(buffer.empty()){
+            current = window_t();
+            source->finish_epoch(role, epoch);
+            return;
+        }
+
+        auto i = generator() % buffer.size();
+
+        current = buffer[i];
+
+        if(!next_window(buffer[i])){
+            buffer[i] = buffer.back();
+            buffer.pop_back();
+        }
+    }
+
+    std::shared_ptr<T> value; ///< The copy of the current window, shared by the copies of the iterator
+
+    bool end = false;
+    bool started = false;
+
+    std::size_t epoch = 0;
+    std::size_t next_file = 0;
+    std::mt19937 generator;
+
+    std::vector<window_t> open;
+    std::vector<window_t> buffer;
+    window_t current;
+};
+
+using shuffle_sample_iterator = shuffle_iterator<ana::sample_t>;
+using shuffle_label_iterator = shuffle_iterator<ana::label_t>;
+
+} //end of namespace ana
+
+#endif
@@ -0,0 +1,136 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_TELEMETRY_HPP
+#define ANA_TEMPLATE_TELEMETRY_HPP
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdint>
+
+#include "config.hpp"
+
+namespace ana {
+
+/*!
+ * \brief The counters of the telemetry
+ */
+enum class counter : std::size_t {
+    BYTES_READ,
+    FILES,
+    FRAMES,
+    WINDOWS,
+    FILE_SWITCHES,
+    BYTES_WRITTEN,
+    ALLOCATIONS,
+    ALLOCATED_BYTES,
+    CACHE_HITS,
+    CACHE_MISSES,
+    CACHE_EVICTIONS,
+    COUNT
+};
+
+/*!
+ * \brief The timed phases of the telemetry. The phases run by several threads
+ * at once are timed for each thread, their time is the sum of the threads.
+ */
+enum class phase : std::size_t {
+    GET_FILES,
+    SCAN,
+    PARSE,
+    NORMALIZE,
+    WINDOWS,
+    FILE_SWITCH,
+    PRETRAINING,
+    FINE_TUNING,
+    FEATURES,
+    WRITE_FEATURES,
+    TEST,
+    COUNT
+};
+
+/*!
+ * \brief The values of the counters and the timers of the run
+ */
+struct telemetry_t {
+    std::atomic<std::uint64_t> counters[std::size_t(counter::COUNT)];
+    std::atomic<std::uint64_t> nanoseconds[std::size_t(phase::COUNT)];
+    std::atomic<std::uint64_t> calls[std::size_t(phase::COUNT)];
+
+    std::chrono::steady_clock::time_point start;
+
+    telemetry_t();
+
+    /*!
+     * \brief Write the report (telemetry_file.json and telemetry_file.csv) and
+     * print a summary
+     */
+    void report() const;
+};
+
+/*!
+ * \brief The telemetry of the program
+ */
+telemetry_t& telemetry();
+
+/*!
+ * \brief Return the number of allocations since the start of the program, 0
+ * if the program was not built with ANA_COUNT_ALLOCATIONS
+ */
+std::size_t allocations();
+
+/*!
+ * \brief Add value to the given counter
+ */
+inline void count(counter c, std::uint64_t value = 1){
+    if(telemetry_enabled){
+        telemetry().counters[std::size_t(c)].fetch_add(value, std::memory_order_relaxed);
+    }
+}
+
+/*!
+ * \brief Add the time between its construction and its destruction to the
+ * given phase. Does nothing when the telemetry is disabled.
+ */
+struct phase_timer {
+    explicit phase_timer(phase p) : p(p) {
+        if(telemetry_enabled){
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    phase_timer(const phase_timer& rhs) = delete;
+    phase_timer& operator=(const phase_timer& rhs) = delete;
+
+    ~phase_timer(){
+        stop();
+    }
+
+    /*!
+     * \brief Stop the timer before its destruction
+     */
+    void stop(){
+        if(telemetry_enabled && !stopped){
+            stopped = true;
+
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+            telemetry().nanoseconds[std::size_t(p)].fetch_add(ns, std::memory_order_relaxed);
+            telemetry().calls[std::size_t(p)].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    phase p;
+    bool stopped = false;
+    std::chrono::steady_clock::time_point start;
+};
+
+} //end of namespace ana
+
+#endif
@@ -0,0 +1,485 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_TRAINING_HPP
+#define ANA_TEMPLATE_TRAINING_HPP
+
+#include <sstream>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <functional>
+
+#include "cpp_utils/data.hpp"
+
+#include "config.hpp"
+#include "data.hpp"
+#include "batch.hpp"
+#include "checkpoint.hpp"
+#include "activation_store.hpp"
+#include "sgd.hpp"
+#include "cd.hpp"
+#include "vocabulary.hpp"
+#include "settings.hpp"
+
+namespace ana {
+
+/*!
+ * \brief Continue the momentum schedule of a RBM or of a DBN from the given
+ * epoch, for a training started in the middle of the schedule. The original
+ * schedule is restored at the destruction.
+ */
+template<typename T>
+struct momentum_schedule {
+    T& trained;
+
+    const double initial_momentum;
+    const std::size_t final_momentum_epoch;
+
+    momentum_schedule(T& trained, std::size_t epoch)
+            : trained(trained), initial_momentum(trained.initial_momentum), final_momentum_epoch(trained.final_momentum_epoch) {
+        if(epoch >= final_momentum_epoch){
+            trained.initial_momentum = trained.final_momentum;
+            trained.final_momentum_epoch = 0;
+        } else {
+            trained.final_momentum_epoch -= epoch;
+        }
+    }
+
+    momentum_schedule(const momentum_schedule& rhs) = delete;
+    momentum_schedule& operator=(const momentum_schedule& rhs) = delete;
+
+    ~momentum_schedule(){
+        trained.initial_momentum = initial_momentum;
+        trained.final_momentum_epoch = final_momentum_epoch;
+    }
+};
+
+/*!
+ * \brief Iterator over the activations of the first layers layers of a DBN
+ * for the windows of another iterator, the input of the next layer.
+ *
+ * The windows are forwarded by blocks of inference_batch windows. The blocks
+ * are shared by the copies of the iterator, a copy lagging behind reuses the
+ * next block if it is still used by another copy. Like the shard_iterator,
+ * dereferencing the iterator copies the current row in a buffer shared by the
+ * copies of the iterator.
+ */
+template<typename DBN, typename Iterator>
+struct layer_input_iterator : std::iterator<std::input_iterator_tag, ana::sample_t> {
+    DBN* dbn;
+    std::size_t layers;
+    Iterator last;
+
+    layer_input_iterator(DBN& dbn, std::size_t layers, Iterator first, Iterator last)
+            : dbn(&dbn), layers(layers), last(last), shared(std::make_shared<shared_t>()) {
+        block = load(first);
+    }
+
+    layer_input_iterator(const layer_input_iterator& rhs) = default;
+    layer_input_iterator& operator=(const layer_input_iterator& rhs) = default;
+
+    bool operator==(const layer_input_iterator& rhs){
+        return block == rhs.block && row == rhs.row;
+    }
+
+    bool operator!=(const layer_input_iterator& rhs){
+        return !(*this == rhs);
+    }
+
+    ana::sample_t& operator*(){
+        auto& value = shared->value;
+
+        if(value.size() != block->size){
+            value = ana::sample_t(block->size);
+        }
+
+        auto first = block->values.data() + row * block->size;
+        std::copy(first, first + block->size, value.memory_start());
+
+        return value;
+    }
+
+    ana::sample_t* operator->(){
+        return &**this;
+    }
+
+    layer_input_iterator& operator++(){
+        if(++row == block->rows){
+            auto next = block->successor.lock();
+
+            if(!next){
+                next = load(block->next);
+                block->successor = next;
+            }
+
+            block = next;
+            row = 0;
+        }
+
+        return *this;
+    }
+
+    layer_input_iterator operator++(int){
+        layer_input_iterator copy = *this;
+        ++(*this);
+        return copy;
+    }
+
+private:
+    //The activations of a block of windows, the end of the range has no block
+    struct block_t {
+        std::vector<float> values;
+        std::size_t rows;
+        std::size_t size;
+        Iterator next;  ///< The window after the block
+        mutable std::weak_ptr<const block_t> successor;
+    };
+
+    //The buffers shared by the copies
+    struct shared_t {
+        batch_forward<DBN> forward;
+        std::vector<float> input;
+        ana::sample_t value;
+    };
+
+    std::shared_ptr<const block_t> load(Iterator it){
+        if(it == last){
+            return nullptr;
+        }
+
+        auto& input = shared->input;
+
+        std::size_t rows = 0;
+
+        for(; rows < inference_batch && it != last; ++rows, ++it){
+            auto& sample = *it;
+
+            if(input.size() < inference_batch * sample.size()){
+                input.resize(inference_batch * sample.size());
+            }
+
+            std::copy(sample.memory_start(), sample.memory_start() + sample.size(), input.begin() + rows * sample.size());
+        }
+
+        auto& forward = shared->forward;
+        forward.run(*dbn, input.data(), rows, layers);
+
+        auto& output = forward.activations[layers - 1];
+
+        return std::make_shared<const block_t>(block_t{output, rows, output.size() / rows, it, {}});
+    }
+
+    std::shared_ptr<shared_t> shared;
+    std::shared_ptr<const block_t> block;
+    std::size_t row = 0;
+};
+
+/*!
+ * \brief The checkpoints of a training: its current state and the writer of
+ * the checkpoint file.
+ *
+ * Without writer, the state is only used to pretrain the layers one after
+ * another and nothing is saved.
+ */
+struct training_checkpoints {
+    checkpoint_t state;
+    std::unique_ptr<checkpoint_writer> writer;
+
+    //The current epoch of the shuffled windows of the stage, if they are shuffled
+    std::function<std::size_t()> shuffle_epoch;
+
+    explicit training_checkpoints(bool save = true){
+        if(save){
+            writer = std::make_unique<checkpoint_writer>(checkpoint_file);
+        }
+    }
+
+    bool enabled() const {
+        return static_cast<bool>(writer);
+    }
+
+    /*!
+     * \brief Save the current state with the given network and the state of
+     * the trainer in the middle of a layer or of the fine-tuning. The network
+     * is serialized by the calling thread and written by the writer thread.
+     */
+    template<typename DBN>
+    void save(const DBN& dbn, trainer_state trainer = trainer_state()){
+        if(!writer){
+            return;
+        }
+
+        std::ostringstream labels;
+        ana::vocabulary().store(labels);
+
+        std::ostringstream network;
+        dbn.store(network);
+
+        if(shuffle_epoch){
+            state.shuffle_epoch = shuffle_epoch();
+        }
+
+        auto checkpoint = state;
+        checkpoint.input = settings().window_size();
+        checkpoint.trainer = std::move(trainer);
+        checkpoint.labels = labels.str();
+        checkpoint.network = network.str();
+
+        writer->push(std::move(checkpoint));
+    }
+};
+
+/*!
+ * \brief Return the number of epochs of the next part of a training, after
+ * which a checkpoint is saved.
+ *
+ * Only the parallel trainers can be kept between the parts, with the DLL
+ * trainers (parallel is false), the whole layer or fine-tuning is one part.
+ */
+inline std::size_t checkpoint_part(const training_checkpoints& checkpoints, std::size_t done, std::size_t epochs, bool parallel){
+    return parallel && checkpoints.enabled() && checkpoint_epochs ? std::min(checkpoint_epochs, epochs - done) : epochs - done;
+}
+
+/*!
+ * \brief Restore the trainer of a layer or of the fine-tuning resumed in its
+ * middle from the state of the checkpoint
+ */
+template<typename Trainer>
+void restore_trainer(Trainer& trainer, checkpoint_t& state){
+    if(state.epoch && !trainer.restore(state.trainer)){
+        std::cout << "The trainer of the checkpoint does not match, its momentum is restarted" << std::endl;
+    }
+
+    state.trainer = trainer_state();
+}
+
+/*!
+ * \brief Forward the inputs of [first, last) through the layers [first_layer,
+ * last_layer) of the DBN, by batches, and store the activations of the layer
+ * last_layer - 1.
+ *
+ * \return the store, or nullptr if it cannot be created
+ */
+template<typename DBN, typename Iterator>
+std::unique_ptr<activation_store> make_activation_store(DBN& dbn, Iterator first, Iterator last, std::size_t first_layer, std::size_t last_layer){
+    auto file = activation_directory.empty() ? std::string() : activation_directory + "/layer_" + std::to_string(last_layer - 1) + ".act";
+
+    std::cout << "Compute the activations of layer " << (last_layer - 1) << std::endl;
+
+    batch_forward<DBN> forward;
+    std::unique_ptr<activation_store> store;
+
+    std::vector<float> input;
+    std::size_t rows = 0;
+
+    auto flush = [&](){
+        forward.run_layers(dbn, input.data(), rows, first_layer, last_layer);
+
+        auto& output = forward.activations[last_layer - 1];
+
+        if(!store){
+            store = std::make_unique<activation_store>(output.size() / rows, file);
+        }
+
+        store->append(output.data(), rows);
+
+        rows = 0;
+    };
+
+    for(; first != last; ++first){
+        auto& sample = *first;
+
+        if(input.empty()){
+            input.resize(inference_batch * sample.size());
+        }
+
+        std::copy(sample.memory_start(), sample.memory_start() + sample.size(), input.begin() + rows * sample.size());
+
+        if(++rows == inference_batch){
+            flush();
+        }
+    }
+
+    if(rows){
+        flush();
+    }
+
+    if(!store || !store->finish()){
+        return nullptr;
+    }
+
+    return store;
+}
+
+namespace detail {
+
+//Train the RBM of the layer I for epochs epochs with the parallel CD, or with the CD of DLL continuing its momentum schedule from first_epoch
+template<std::size_t I, typename RBM, typename Iterator>
+void train_rbm(RBM& rbm, cd_trainer* cd, Iterator first, Iterator last, std::size_t epochs, std::size_t first_epoch){
+    if(cd){
+        parallel_train_rbm(rbm, *cd, first, last, epochs);
+    } else {
+        momentum_schedule<RBM> schedule(rbm, first_epoch);
+        rbm.train(first, last, epochs);
+    }
+}
+
+template<std::size_t I, typename DBN, typename Iterator, cpp_enable_if((I == DBN::layers))>
+void pretrain_layer(DBN&, Iterator, Iterator, std::size_t, training_checkpoints&, std::unique_ptr<activation_store>){
+    //Done
+}
+
+template<std::size_t I, typename DBN, typename Iterator, cpp_enable_if((I < DBN::layers))>
+void pretrain_layer(DBN& dbn, Iterator first, Iterator last, std::size_t epochs, training_checkpoints& checkpoints, std::unique_ptr<activation_store> input){
+    auto& state = checkpoints.state;
+
+    if(I >= state.layer){
+        auto& rbm = dbn.template layer_get<I>();
+
+        std::cout << "Pretrain layer " << I << " from epoch " << state.epoch << std::endl;
+
+        //The same parallel trainer is used for all the parts of the layer
+        std::unique_ptr<cd_trainer> cd;
+
+        if(parallel_cd){
+            cd = std::make_unique<cd_trainer>(make_cd_layer(rbm), cd_threads, cd_seed, I);
+            restore_trainer(*cd, state);
+
+            std::cout << "Parallel CD with " << cd->threads() << " threads" << std::endl;
+        }
+
+        while(state.epoch < epochs){
+            auto part = checkpoint_part(checkpoints, state.epoch, epochs, parallel_cd);
+
+            if(I == 0){
+                train_rbm<I>(rbm, cd.get(), first, last, part, state.epoch);
+            } else if(input){
+                activation_iterator store_first(*input);
+                activation_iterator store_last(*input, input->rows());
+
+                train_rbm<I>(rbm, cd.get(), store_first, store_last, part, state.epoch);
+            } else {
+                layer_input_iterator<DBN, Iterator> input_first(dbn, I, first, last);
+                layer_input_iterator<DBN, Iterator> input_last(dbn, I, last, last);
+
+                train_rbm<I>(rbm, cd.get(), input_first, input_last, part, state.epoch);
+            }
+
+            state.epoch += part;
+
+            //Only the parallel trainer stops in the middle of the layer
+            if(state.epoch < epochs){
+                checkpoints.save(dbn, cd->state());
+            }
+        }
+
+        state.layer = I + 1;
+        state.epoch = 0;
+
+        checkpoints.save(dbn);
+    }
+
+    //The input of the next layer is computed once, from the input of this layer
+
+    if(activation_stores && I + 1 < DBN::layers && I + 1 >= state.layer){
+        if(input){
+            input = make_activation_store(dbn, activation_iterator(*input), activation_iterator(*input, input->rows()), I, I + 1);
+        } else {
+            input = make_activation_store(dbn, first, last, 0, I + 1);
+        }
+    }
+
+    pretrain_layer<I + 1>(dbn, first, last, epochs, checkpoints, std::move(input));
+}
+
+} //end of namespace detail
+
+/*!
+ * \brief Pretrain the layers of the DBN one after another, from the state of
+ * the checkpoints. A checkpoint is saved at the end of each layer and every
+ * checkpoint_epochs epochs.
+ *
+ * The input of the layer I is computed from the windows by the first I
+ * layers. With activation_stores, it is computed once, from the input of the
+ * layer I - 1, and read from an activation store for all the epochs. With
+ * parallel_cd, the trainer of a layer is kept between its parts and saved in
+ * the checkpoints, with the CD of DLL, a checkpoint is only saved at the end of
+ * each layer.
+ */
+template<typename DBN, typename Iterator>
+void pretrain_layers(DBN& dbn, Iterator first, Iterator last, std::size_t epochs, training_checkpoints& checkpoints){
+    auto& state = checkpoints.state;
+
+    if(state.stage != training_stage::PRETRAINING){
+        return;
+    }
+
+    detail::pretrain_layer<0>(dbn, first, last, epochs, checkpoints, nullptr);
+
+    state.stage = training_stage::FINE_TUNING;
+    state.layer = 0;
+    state.epoch = 0;
+    state.shuffle_epoch = 0;
+}
+
+/*!
+ * \brief Fine-tune the DBN from the state of the checkpoints, saving a
+ * checkpoint every checkpoint_epochs epochs and at the end. With
+ * parallel_sgd, the trainer is kept between the parts and saved in the
+ * checkpoints, with the SGD of DLL, a checkpoint is only saved at the end.
+ *
+ * \return the error of the last epoch
+ */
+template<typename DBN, typename Iterator, typename LIterator>
+double fine_tune_epochs(DBN& dbn, Iterator first, Iterator last, LIterator lfirst, LIterator llast, std::size_t epochs, training_checkpoints& checkpoints){
+    auto& state = checkpoints.state;
+
+    double error = 0.0;
+
+    if(state.stage != training_stage::FINE_TUNING){
+        return error;
+    }
+
+    std::cout << "Fine-tune from epoch " << state.epoch << std::endl;
+
+    //The same parallel trainer is used for all the parts of the fine-tuning
+    std::unique_ptr<sgd_trainer> sgd;
+
+    if(parallel_sgd){
+        sgd = std::make_unique<sgd_trainer>(make_sgd_layers(dbn), sgd_threads);
+        restore_trainer(*sgd, state);
+
+        std::cout << "Parallel SGD with " << sgd->threads() << " threads" << (hogwild_sgd ? " (hogwild)" : "") << std::endl;
+    }
+
+    while(state.epoch < epochs){
+        auto part = checkpoint_part(checkpoints, state.epoch, epochs, parallel_sgd);
+
+        if(sgd){
+            error = parallel_fine_tune(dbn, *sgd, first, last, lfirst, llast, part);
+        } else {
+            momentum_schedule<DBN> schedule(dbn, state.epoch);
+            error = dbn.fine_tune(first, last, lfirst, llast, part);
+        }
+
+        state.epoch += part;
+
+        if(state.epoch == epochs){
+            state.stage = training_stage::DONE;
+            checkpoints.save(dbn);
+        } else {
+            checkpoints.save(dbn, sgd->state());
+        }
+    }
+
+    return error;
+}
+
+} //end of namespace ana
+
+#endif
@@ -0,0 +1,94 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_VOCABULARY_HPP
+#define ANA_TEMPLATE_VOCABULARY_HPP
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <iosfwd>
+
+namespace ana {
+
+/*!
+ * \brief The set of labels and their ids.
+ *
+ * The vocabulary is built by scanning the label files and then frozen. Once
+ * frozen, the lookups use a perfect hash over the labels, they are lock-free
+ * and do not allocate.
+ */
+struct label_vocabulary {
+    static constexpr const std::size_t npos = static_cast<std::size_t>(-1);
+
+    /*!
+     * \brief Add the window labels of the given files to the vocabulary.
+     *
+     * The new labels get the next ids, in lexicographic order, so that the
+     * ids do not depend on the order of the files.
+     */
+    void build(const std::vector<std::string>& label_files, std::size_t threads);
+
+    /*!
+     * \brief Freeze the vocabulary, no labels can be added after this.
+     */
+    void freeze();
+
+    bool frozen() const {
+        return !table.empty();
+    }
+
+    std::size_t size() const {
+        return names.size();
+    }
+
+    const std::string& name(std::size_t id) const {
+        return names[id];
+    }
+
+    /*!
+     * \brief Return the id of the given label or npos if it is not part of
+     * the vocabulary. The vocabulary must be frozen.
+     */
+    std::size_t id(const char* label, std::size_t length) const;
+
+    std::size_t id(const std::string& label) const {
+        return id(label.data(), label.size());
+    }
+
+    bool store(const std::string& file) const;
+    bool load(const std::string& file);
+
+    /*!
+     * \brief Store the labels to the stream, one per line
+     */
+    bool store(std::ostream& out) const;
+
+    /*!
+     * \brief Load the labels of the stream until its end
+     * \return false if a label appears twice
+     */
+    bool load(std::istream& in);
+
+private:
+    std::uint64_t hash(const char* label, std::size_t length) const;
+
+    std::vector<std::string> names;
+
+    std::uint64_t seed = 0;
+    std::size_t mask = 0;
+    std::vector<std::uint32_t> table; ///< id + 1 of the label of each slot, 0 for empty slots
+};
+
+/*!
+ * \brief The label vocabulary of the program
+ */
+label_vocabulary& vocabulary();
+
+} //end of namespace ana
+
+#endif
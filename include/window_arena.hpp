@@ -0,0 +1,147 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef ANA_TEMPLATE_WINDOW_ARENA_HPP
+#define ANA_TEMPLATE_WINDOW_ARENA_HPP
+
+#include <vector>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+
+#include "config.hpp"
+
+namespace ana {
+
+struct frames_t;
+
+/*!
+ * \brief The windows of a file, stored in a single aligned block as a
+ * row-major matrix of windows x (features * n) floats.
+ *
+ * The block is only reallocated when it grows, so reusing an arena for
+ * several files does not allocate once it is large enough.
+ */
+struct window_arena {
+    static constexpr const std::size_t alignment = 64;
+
+    window_arena() = default;
+
+    window_arena(window_arena&& rhs) noexcept {
+        swap(rhs);
+    }
+
+    window_arena& operator=(window_arena&& rhs) noexcept {
+        window_arena moved(std::move(rhs));
+        swap(moved);
+        return *this;
+    }
+
+    window_arena(const window_arena& rhs) = delete;
+    window_arena& operator=(const window_arena& rhs) = delete;
+
+    /*!
+     * \brief Set the number of windows, of the configured size. The content
+     * of the windows is lost if the block needs to grow
+     */
+    void resize(std::size_t windows);
+
+    /*!
+     * \brief Keep only the first windows windows
+     */
+    void truncate(std::size_t windows){
+        count = std::min(count, windows);
+    }
+
+    std::size_t windows() const {
+        return count;
+    }
+
+    /*!
+     * \brief The number of values of each window
+     */
+    std::size_t window_size() const {
+        return size;
+    }
+
+    bool empty() const {
+        return !count;
+    }
+
+    float* data(){
+        return memory.get();
+    }
+
+    const float* data() const {
+        return memory.get();
+    }
+
+    float* window(std::size_t i){
+        return memory.get() + i * size;
+    }
+
+    const float* window(std::size_t i) const {
+        return memory.get() + i * size;
+    }
+
+    /*!
+     * \brief Copy the window i in sample, which must have the size of a window
+     */
+    template<typename Sample>
+    void copy_window(std::size_t i, Sample& sample) const {
+        std::memcpy(sample.memory_start(), window(i), size * sizeof(float));
+    }
+
+    /*!
+     * \brief Append a copy of each window to samples
+     */
+    template<typename Sample>
+    void append_to(std::vector<Sample>& samples) const {
+        samples.reserve(samples.size() + count);
+
+        for(std::size_t i = 0; i < count; ++i){
+            samples.emplace_back(size);
+            copy_window(i, samples.back());
+        }
+    }
+
+    void swap(window_arena& rhs) noexcept {
+        std::swap(memory, rhs.memory);
+        std::swap(size, rhs.size);
+        std::swap(count, rhs.count);
+        std::swap(capacity, rhs.capacity);
+    }
+
+private:
+    struct free_deleter {
+        void operator()(float* memory) const {
+            std::free(memory);
+        }
+    };
+
+    std::unique_ptr<float[], free_deleter> memory;
+    std::size_t size = 0;
+    std::size_t count = 0;
+    std::size_t capacity = 0; ///< The number of floats of the block
+};
+
+/*!
+ * \brief Return the number of windows of n frames, every stride frames, of a
+ * file of the given number of frames
+ */
+std::size_t count_windows(std::size_t frames);
+
+/*!
+ * \brief Fill the arena with the windows of n frames, every stride frames.
+ */
+void assemble_windows(const frames_t& frames, window_arena& windows);
+
+} //end of namespace ana
+
+#endif
@@ -0,0 +1,92 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "activation_store.hpp"
+
+ana::activation_store::activation_store(std::size_t size, const std::string& file) : size(size), file(file) {
+    if(!file.empty()){
+        fp = std::fopen(file.c_str(), "wb");
+
+        if(!fp){
+            std::cout << "Impossible to create the activation store \"" << file << "\"" << std::endl;
+            valid = false;
+        }
+    }
+}
+
+ana::activation_store::~activation_store(){
+    if(fp){
+        std::fclose(fp);
+        std::remove(file.c_str());
+    }
+
+    if(mapping){
+        munmap(mapping, mapping_size);
+    }
+}
+
+void ana::activation_store::append(const float* values, std::size_t rows){
+    if(file.empty()){
+        this->values.insert(this->values.end(), values, values + rows * size);
+    } else if(valid){
+        valid = std::fwrite(values, sizeof(float), rows * size, fp) == rows * size;
+    }
+
+    count += rows;
+}
+
+bool ana::activation_store::finish(){
+    if(file.empty()){
+        data = values.data();
+        return true;
+    }
+
+    if(!fp){
+        return false;
+    }
+
+    valid = std::fclose(fp) == 0 && valid;
+    fp = nullptr;
+
+    if(valid && count && size){
+        auto fd = open(file.c_str(), O_RDONLY);
+
+        if(fd >= 0){
+            mapping_size = count * size * sizeof(float);
+            mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+
+            //The mapping stays valid after the descriptor is closed
+            close(fd);
+
+            if(mapping == MAP_FAILED){
+                mapping = nullptr;
+            } else {
+                //The rows are traversed in order, the kernel can read ahead
+                madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+            }
+        }
+
+        valid = mapping != nullptr;
+        data = static_cast<const float*>(mapping);
+    }
+
+    //The mapping stays valid after the file is removed
+    std::remove(file.c_str());
+
+    if(!valid){
+        std::cout << "Impossible to write the activation store \"" << file << "\"" << std::endl;
+    }
+
+    return valid;
+}
@@ -0,0 +1,78 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+//Replacement of the global allocation functions to count the allocations of
+//the telemetry and of the benchmarks. The replacement is only compiled with
+//ANA_COUNT_ALLOCATIONS, otherwise the allocations are not counted and do not
+//pay for the counters.
+
+#include <new>
+#include <atomic>
+#include <cstdlib>
+
+#include "telemetry.hpp"
+
+#ifdef ANA_COUNT_ALLOCATIONS
+
+namespace {
+
+std::atomic<std::size_t> allocations_count(0);
+
+} //end of anonymous namespace
+
+std::size_t ana::allocations(){
+    return allocations_count.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size){
+    allocations_count.fetch_add(1, std::memory_order_relaxed);
+
+    ana::count(ana::counter::ALLOCATIONS);
+    ana::count(ana::counter::ALLOCATED_BYTES, size);
+
+    while(true){
+        if(auto memory = std::malloc(size ? size : 1)){
+            return memory;
+        }
+
+        auto handler = std::get_new_handler();
+
+        if(!handler){
+            throw std::bad_alloc();
+        }
+
+        handler();
+    }
+}
+
+void* operator new[](std::size_t size){
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+#else
+
+std::size_t ana::allocations(){
+    return 0;
+}
+
+#endif
@@ -0,0 +1,65 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifdef ETL_MKL_MODE
+#include "mkl_cblas.h"
+#endif
+
+#include "blas.hpp"
+
+//The loops are ordered to stream over the rows of B and C, each value of C
+//being summed in the order of k
+
+void ana::ordered_gemm(bool trans_a, bool trans_b, std::size_t m, std::size_t n, std::size_t k,
+          float alpha, const float* a, std::size_t lda, const float* b, std::size_t ldb,
+          float beta, float* c, std::size_t ldc){
+    for(std::size_t i = 0; i < m; ++i){
+        float* c_row = c + i * ldc;
+
+        for(std::size_t j = 0; j < n; ++j){
+            c_row[j] = beta == 0.0f ? 0.0f : beta * c_row[j];
+        }
+
+        for(std::size_t p = 0; p < k; ++p){
+            float a_ip = alpha * (trans_a ? a[p * lda + i] : a[i * lda + p]);
+
+            if(trans_b){
+                for(std::size_t j = 0; j < n; ++j){
+                    c_row[j] += a_ip * b[j * ldb + p];
+                }
+            } else {
+                const float* b_row = b + p * ldb;
+
+                for(std::size_t j = 0; j < n; ++j){
+                    c_row[j] += a_ip * b_row[j];
+                }
+            }
+        }
+    }
+}
+
+#ifdef ETL_MKL_MODE
+
+void ana::gemm(bool trans_a, bool trans_b, std::size_t m, std::size_t n, std::size_t k,
+          float alpha, const float* a, std::size_t lda, const float* b, std::size_t ldb,
+          float beta, float* c, std::size_t ldc){
+    cblas_sgemm(CblasRowMajor,
+        trans_a ? CblasTrans : CblasNoTrans, trans_b ? CblasTrans : CblasNoTrans,
+        m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
+
+#else
+
+//Simple fallback
+
+void ana::gemm(bool trans_a, bool trans_b, std::size_t m, std::size_t n, std::size_t k,
+          float alpha, const float* a, std::size_t lda, const float* b, std::size_t ldb,
+          float beta, float* c, std::size_t ldc){
+    ordered_gemm(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
+
+#endif
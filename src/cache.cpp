@@ -0,0 +1,175 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.hpp"
+#include "cache.hpp"
+#include "normalization.hpp"
+#include "settings.hpp"
+
+namespace {
+
+constexpr const char magic[8] = {'A', 'N', 'A', 'W', 'I', 'N', 'D', 'W'};
+
+//Must be incremented each time the layout of the cache changes
+constexpr const std::uint32_t version = 3;
+
+std::atomic<std::size_t> temporaries(0);
+
+struct header_t {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t n;
+    std::uint32_t stride;
+    std::uint32_t features;
+    std::uint32_t dropped;
+    std::uint32_t path_length;
+    std::uint32_t normalization;
+    std::uint64_t normalization_key;
+    std::int64_t mtime_sec;
+    std::int64_t mtime_nsec;
+    std::uint64_t size;
+    std::uint64_t windows;
+    std::uint64_t frames;
+};
+
+std::string cache_file(const std::string& file, bool dropped){
+    std::string suffix = dropped ? ".nosil.wcache" : ".wcache";
+
+    if(cache_directory.empty()){
+        return file + suffix;
+    }
+
+    //Flatten the path so that files with the same name in different folders do not collide
+    std::string flat(file);
+    std::replace(flat.begin(), flat.end(), '/', '_');
+
+    return cache_directory + "/" + flat + suffix;
+}
+
+bool make_header(const std::string& file, bool dropped, header_t& header){
+    struct stat buffer;
+
+    if(stat(file.c_str(), &buffer) != 0){
+        return false;
+    }
+
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+
+    header.version     = version;
+    header.n           = ana::settings().n;
+    header.stride      = ana::settings().stride;
+    header.features    = ana::settings().features;
+    header.dropped     = dropped;
+    header.path_length = file.size();
+    header.normalization = static_cast<std::uint32_t>(normalization);
+    header.normalization_key = ana::normalization_key(file);
+    header.mtime_sec   = buffer.st_mtim.tv_sec;
+    header.mtime_nsec  = buffer.st_mtim.tv_nsec;
+    header.size        = buffer.st_size;
+
+    return true;
+}
+
+} //end of anonymous namespace
+
+bool ana::load_cached_windows(const std::string& file, bool dropped, window_arena& windows, std::size_t& frames){
+    header_t expected;
+    if(!make_header(file, dropped, expected)){
+        return false;
+    }
+
+    auto fp = std::fopen(cache_file(file, dropped).c_str(), "rb");
+
+    if(!fp){
+        return false;
+    }
+
+    header_t header;
+    std::string path(expected.path_length, ' ');
+
+    bool valid =
+            std::fread(&header, sizeof(header), 1, fp) == 1
+        &&  std::memcmp(&header, &expected, offsetof(header_t, windows)) == 0
+        &&  std::fread(&path[0], 1, path.size(), fp) == path.size()
+        &&  path == file;
+
+    //The number of windows is not trusted before it is checked against the size of the file
+    if(valid){
+        struct stat buffer;
+
+        auto offset = std::ftell(fp);
+        auto window_bytes = ana::settings().window_size() * sizeof(float);
+
+        valid =
+                offset >= 0
+            &&  fstat(fileno(fp), &buffer) == 0
+            &&  static_cast<std::uint64_t>(buffer.st_size) >= static_cast<std::uint64_t>(offset)
+            &&  header.windows == (buffer.st_size - offset) / window_bytes
+            &&  (buffer.st_size - offset) % window_bytes == 0;
+    }
+
+    if(valid){
+        frames = header.frames;
+
+        windows.resize(header.windows);
+
+        auto size = header.windows * windows.window_size();
+        valid = std::fread(windows.data(), sizeof(float), size, fp) == size;
+    }
+
+    std::fclose(fp);
+
+    return valid;
+}
+
+void ana::store_cached_windows(const std::string& file, bool dropped, const window_arena& windows, std::size_t frames){
+    header_t header;
+    if(!make_header(file, dropped, header)){
+        return;
+    }
+
+    header.windows = windows.windows();
+    header.frames  = frames;
+
+    auto target = cache_file(file, dropped);
+
+    //Write to a temporary file first so that a concurrent reader never sees a partial cache
+    auto temp = target + ".tmp" + std::to_string(getpid()) + "_" + std::to_string(temporaries++);
+
+    auto fp = std::fopen(temp.c_str(), "wb");
+
+    if(!fp){
+        std::cout << "Impossible to create the cache file \"" << temp << "\"" << std::endl;
+        return;
+    }
+
+    auto size = windows.windows() * windows.window_size();
+
+    bool valid =
+            std::fwrite(&header, sizeof(header), 1, fp) == 1
+        &&  std::fwrite(file.data(), 1, file.size(), fp) == file.size()
+        &&  std::fwrite(windows.data(), sizeof(float), size, fp) == size;
+
+    valid = std::fclose(fp) == 0 && valid;
+
+    if(!valid || std::rename(temp.c_str(), target.c_str()) != 0){
+        std::cout << "Impossible to write the cache file \"" << target << "\"" << std::endl;
+        std::remove(temp.c_str());
+    }
+}
@@ -0,0 +1,224 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <algorithm>
+#include <cstdint>
+
+#include "cd.hpp"
+#include "sgd.hpp"
+#include "batch.hpp"
+#include "blas.hpp"
+
+namespace {
+
+//Scramble the given key (splitmix64)
+std::uint64_t mix(std::uint64_t key){
+    key += 0x9E3779B97F4A7C15ULL;
+    key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+    return key ^ (key >> 31);
+}
+
+//Return a uniform value in [0, 1) for the given key
+float uniform(std::uint64_t key){
+    return (mix(key) >> 40) * (1.0f / (1ULL << 24));
+}
+
+//Compute the linear activations output = input * w + bias (or input * w^T + bias)
+void linear(const float* input, const float* w, const float* bias, float* output, std::size_t rows, std::size_t n_in, std::size_t n_out, bool transposed){
+    for(std::size_t r = 0; r < rows; ++r){
+        std::copy(bias, bias + n_out, output + r * n_out);
+    }
+
+    if(transposed){
+        ana::gemm(false, true, rows, n_out, n_in, 1.0f, input, n_in, w, n_in, 1.0f, output, n_out);
+    } else {
+        ana::gemm(false, false, rows, n_out, n_in, 1.0f, input, n_in, w, n_out, 1.0f, output, n_out);
+    }
+}
+
+} //end of anonymous namespace
+
+ana::cd_trainer::cd_trainer(cd_layer layer, std::size_t threads, std::size_t seed, std::size_t index)
+        : layer(layer), layer_stream(mix(mix(seed) + index)), pool(threads) {
+    workers.resize(pool.size());
+
+    for(auto& worker : workers){
+        worker.w_grad.resize(layer.visible * layer.hidden);
+        worker.b_grad.resize(layer.hidden);
+        worker.c_grad.resize(layer.visible);
+    }
+
+    w_inc.resize(layer.visible * layer.hidden);
+    b_inc.resize(layer.hidden);
+    c_inc.resize(layer.visible);
+}
+
+void ana::cd_trainer::gradients(worker_t& worker, const float* v1, std::size_t rows, std::size_t first_row){
+    const auto visible = layer.visible;
+    const auto hidden = layer.hidden;
+
+    worker.h1_a.resize(rows * hidden);
+    worker.h1_s.resize(rows * hidden);
+    worker.v2_a.resize(rows * visible);
+    worker.h2_a.resize(rows * hidden);
+
+    //1. Positive phase
+
+    linear(v1, layer.w, layer.b, worker.h1_a.data(), rows, visible, hidden, false);
+    detail::activate(layer.hidden_unit, worker.h1_a.data(), rows, hidden);
+
+    //2. Sampling of the hidden units, the other units than binary and softmax use their mean
+
+    for(std::size_t r = 0; r < rows; ++r){
+        auto key = stream + (first_row + r) * hidden;
+        auto a = worker.h1_a.data() + r * hidden;
+        auto s = worker.h1_s.data() + r * hidden;
+
+        if(layer.hidden_unit == dll::unit_type::BINARY){
+            for(std::size_t h = 0; h < hidden; ++h){
+                s[h] = uniform(key + h) < a[h] ? 1.0f : 0.0f;
+            }
+        } else if(layer.hidden_unit == dll::unit_type::SOFTMAX){
+            auto u = uniform(key);
+            float sum = 0.0f;
+
+            std::size_t h = 0;
+            while(h + 1 < hidden && (sum += a[h]) <= u){
+                ++h;
+            }
+
+            std::fill(s, s + hidden, 0.0f);
+            s[h] = 1.0f;
+        } else {
+            std::copy(a, a + hidden, s);
+        }
+    }
+
+    //3. Negative phase, the gaussian visible units are linear
+
+    linear(worker.h1_s.data(), layer.w, layer.c, worker.v2_a.data(), rows, hidden, visible, true);
+    detail::activate(layer.visible_unit, worker.v2_a.data(), rows, visible);
+
+    linear(worker.v2_a.data(), layer.w, layer.b, worker.h2_a.data(), rows, visible, hidden, false);
+    detail::activate(layer.hidden_unit, worker.h2_a.data(), rows, hidden);
+
+    //4. Gradients: w_grad = v1^T * h1_a - v2_a^T * h2_a
+
+    gemm(true, false, visible, hidden, rows, 1.0f, v1, visible, worker.h1_a.data(), hidden, 0.0f, worker.w_grad.data(), hidden);
+    gemm(true, false, visible, hidden, rows, -1.0f, worker.v2_a.data(), visible, worker.h2_a.data(), hidden, 1.0f, worker.w_grad.data(), hidden);
+
+    std::fill(worker.b_grad.begin(), worker.b_grad.end(), 0.0f);
+    std::fill(worker.c_grad.begin(), worker.c_grad.end(), 0.0f);
+
+    worker.error = 0.0;
+
+    for(std::size_t r = 0; r < rows; ++r){
+        for(std::size_t h = 0; h < hidden; ++h){
+            worker.b_grad[h] += worker.h1_a[r * hidden + h] - worker.h2_a[r * hidden + h];
+        }
+
+        for(std::size_t v = 0; v < visible; ++v){
+            auto diff = v1[r * visible + v] - worker.v2_a[r * visible + v];
+
+            worker.c_grad[v] += diff;
+            worker.error += diff * diff;
+        }
+    }
+}
+
+double ana::cd_trainer::step(const std::vector<float>& batch, const cd_parameters& parameters){
+    auto rows = batch.size() / layer.visible;
+    auto slices = std::min(threads(), rows);
+
+    //1. Each thread computes the gradients of its slice of the batch
+
+    pool.run([&](std::size_t t){
+        if(t < slices){
+            auto first = t * rows / slices;
+            auto last = (t + 1) * rows / slices;
+
+            gradients(workers[t], batch.data() + first * layer.visible, last - first, windows + first);
+        }
+    });
+
+    //2. Each thread reduces and updates a part of the weights
+
+    pool.run([&](std::size_t t){
+        auto part = [&](std::size_t n, std::vector<float> worker_t::* grads, std::vector<float>& inc, float* value, float cost){
+            auto first = t * n / threads();
+            auto last = (t + 1) * n / threads();
+
+            auto grad = (workers[0].*grads).data();
+
+            for(std::size_t s = 1; s < slices; ++s){
+                auto other = (workers[s].*grads).data();
+
+                for(std::size_t i = first; i < last; ++i){
+                    grad[i] += other[i];
+                }
+            }
+
+            momentum_update(first, last, grad, inc.data(), value, cost, rows, parameters.learning_rate, parameters.momentum);
+        };
+
+        part(layer.visible * layer.hidden, &worker_t::w_grad, w_inc, layer.w, parameters.weight_cost);
+        part(layer.hidden, &worker_t::b_grad, b_inc, layer.b, 0.0f);
+        part(layer.visible, &worker_t::c_grad, c_inc, layer.c, 0.0f);
+    });
+
+    windows += rows;
+
+    double error = 0.0;
+
+    for(std::size_t s = 0; s < slices; ++s){
+        error += workers[s].error;
+    }
+
+    return error;
+}
+
+void ana::cd_trainer::start_epoch(std::size_t epoch){
+    stream = mix(layer_stream + epoch);
+    windows = 0;
+}
+
+double ana::cd_trainer::epoch(bounded_queue<std::vector<float>>& batches, const cd_parameters& parameters){
+    start_epoch(trained_epochs);
+
+    double error = 0.0;
+
+    std::vector<float> batch;
+
+    while(batches.pop(batch)){
+        error += step(batch, parameters);
+    }
+
+    ++trained_epochs;
+
+    return error;
+}
+
+ana::trainer_state ana::cd_trainer::state() const {
+    return {trained_epochs, {w_inc, b_inc, c_inc}};
+}
+
+bool ana::cd_trainer::restore(const trainer_state& state){
+    auto& increments = state.increments;
+
+    if(increments.size() != 3 || increments[0].size() != w_inc.size() || increments[1].size() != b_inc.size() || increments[2].size() != c_inc.size()){
+        return false;
+    }
+
+    w_inc = increments[0];
+    b_inc = increments[1];
+    c_inc = increments[2];
+
+    trained_epochs = state.epochs;
+
+    return true;
+}
@@ -0,0 +1,154 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+
+#include "checkpoint.hpp"
+
+namespace {
+
+//Must be incremented each time the layout of the checkpoints changes
+constexpr const std::size_t version = 3;
+
+bool write_checkpoint(const std::string& file, const ana::checkpoint_t& checkpoint){
+    std::ofstream out(file, std::ios::binary);
+
+    out << "ana-checkpoint " << version << "\n";
+    out << static_cast<std::size_t>(checkpoint.stage) << " " << checkpoint.layer << " " << checkpoint.epoch << " " << checkpoint.shuffle_epoch << " " << checkpoint.input << "\n";
+    out << "trainer " << checkpoint.trainer.epochs << " " << checkpoint.trainer.increments.size() << "\n";
+
+    for(auto& increments : checkpoint.trainer.increments){
+        out << increments.size() << "\n";
+        out.write(reinterpret_cast<const char*>(increments.data()), increments.size() * sizeof(float));
+    }
+
+    out << "labels " << checkpoint.labels.size() << "\n";
+    out.write(checkpoint.labels.data(), checkpoint.labels.size());
+    out << "network " << checkpoint.network.size() << "\n";
+    out.write(checkpoint.network.data(), checkpoint.network.size());
+
+    out.close();
+
+    return static_cast<bool>(out);
+}
+
+//Read a "name size" line followed by size bytes
+bool read_block(std::istream& in, const std::string& name, std::string& block){
+    std::string key;
+    std::size_t size;
+
+    if(!(in >> key >> size) || key != name || in.get() != '\n'){
+        return false;
+    }
+
+    block.resize(size);
+
+    return static_cast<bool>(in.read(&block[0], size));
+}
+
+//Read the "trainer epochs count" line followed by the increments, each a "size" line and size floats
+bool read_trainer(std::istream& in, ana::trainer_state& trainer){
+    std::string key;
+    std::size_t count;
+
+    if(!(in >> key >> trainer.epochs >> count) || key != "trainer" || in.get() != '\n'){
+        return false;
+    }
+
+    trainer.increments.resize(count);
+
+    for(auto& increments : trainer.increments){
+        std::size_t size;
+
+        if(!(in >> size) || in.get() != '\n'){
+            return false;
+        }
+
+        increments.resize(size);
+
+        if(!in.read(reinterpret_cast<char*>(increments.data()), size * sizeof(float))){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} //end of anonymous namespace
+
+bool ana::load_checkpoint(const std::string& file, checkpoint_t& checkpoint){
+    std::ifstream in(file, std::ios::binary);
+
+    std::string line;
+    if(!std::getline(in, line) || line != "ana-checkpoint " + std::to_string(version)){
+        return false;
+    }
+
+    std::size_t stage;
+    if(!(in >> stage >> checkpoint.layer >> checkpoint.epoch >> checkpoint.shuffle_epoch >> checkpoint.input) || in.get() != '\n' || stage > std::size_t(training_stage::DONE)){
+        return false;
+    }
+
+    checkpoint.stage = static_cast<training_stage>(stage);
+
+    return read_trainer(in, checkpoint.trainer) && read_block(in, "labels", checkpoint.labels) && read_block(in, "network", checkpoint.network);
+}
+
+ana::checkpoint_writer::checkpoint_writer(const std::string& file) : file(file) {
+    thread = std::thread([this](){ run(); });
+}
+
+ana::checkpoint_writer::~checkpoint_writer(){
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopped = true;
+    }
+
+    ready.notify_one();
+    thread.join();
+}
+
+void ana::checkpoint_writer::push(checkpoint_t checkpoint){
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        next = std::move(checkpoint);
+        pending = true;
+    }
+
+    ready.notify_one();
+}
+
+void ana::checkpoint_writer::run(){
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while(true){
+        ready.wait(lock, [this]{ return pending || stopped; });
+
+        if(!pending){
+            return;
+        }
+
+        auto checkpoint = std::move(next);
+        pending = false;
+
+        lock.unlock();
+
+        auto temp = file + ".tmp";
+
+        if(write_checkpoint(temp, checkpoint) && std::rename(temp.c_str(), file.c_str()) == 0){
+            std::cout << "Checkpoint written (epoch " << checkpoint.epoch << " of " << (checkpoint.stage == training_stage::PRETRAINING
+                ? "layer " + std::to_string(checkpoint.layer) : "fine-tuning") << ")" << std::endl;
+        } else {
+            std::cout << "Impossible to write the checkpoint \"" << file << "\"" << std::endl;
+            std::remove(temp.c_str());
+        }
+
+        lock.lock();
+    }
+}
@@ -10,10 +10,23 @@
 #include <algorithm>
 #include <unordered_map>
 #include <sstream>
+#include <chrono>
+#include <numeric>
+#include <cstring>
 
 #include "config.hpp"
 #include "io.hpp"
+#include "telemetry.hpp"
 #include "data.hpp"
+#include "frames.hpp"
+#include "cache.hpp"
+#include "memory_cache.hpp"
+#include "window_arena.hpp"
+#include "normalization.hpp"
+#include "parallel.hpp"
+#include "vocabulary.hpp"
+#include "settings.hpp"
+#include "scan.hpp"
 
 namespace {
 
@@ -27,29 +40,93 @@ std::string remove_extension(const std::string& file, const std::vector<std::str
             continue;
         }
 
-        if(std::string(file.begin() + file.size() - extension_length, file.end()) == extension){
-            return std::string(file.begin(), file.begin() + file.size() - extension_length);
+        if(file.compare(file.size() - extension_length, extension_length, extension) == 0){
+            return file.substr(0, file.size() - extension_length);
         }
     }
 
     return file;
 }
 
-} //end of anonymous namespace
+//Remove the parent directory of the file (a/b/c/d gives a/b//d)
+std::string drop_parent(const std::string& file){
+    auto last = file.find_last_of('/');
+    auto prelast = file.find_last_of('/', last - 1);
+
+    return std::string(file.begin(), file.begin() + prelast + 1) + std::string(file.begin() + last, file.end());
+}
 
-std::unordered_map<std::string, std::size_t> mapper;
+using clock_type = std::chrono::steady_clock;
 
-std::unordered_map<std::size_t, std::string> ana::reverse_mapper(){
-    std::unordered_map<std::size_t, std::string> rmap;
+void print_throughput(const std::string& phase, const std::vector<std::string>& files, std::size_t frames, clock_type::time_point start){
+    auto end = clock_type::now();
+    auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
 
-    for(auto& v : mapper){
-        rmap[v.second] = v.first;
+    std::size_t bytes = 0;
+    for(auto& file : files){
+        bytes += ana::file_size(file);
     }
 
-    return rmap;
+    std::cout << "Read " << files.size() << " " << phase << " files in " << seconds << "s ("
+        << (bytes / (1024.0 * 1024.0)) / seconds << " MB/s, "
+        << frames / seconds << " frames/s)" << std::endl;
 }
 
-void read_labels_str(const std::string& file, std::vector<std::string>& labels){
+//Each window must have its label
+void check_labels(const std::string& samples_file, const std::string& labels_file, const ana::window_arena& windows, const std::vector<std::string>& labels){
+    if(labels.size() != windows.windows()){
+        std::cout << "Inconsistency between labels and samples windows" << std::endl;
+        std::cout << "features file: " << samples_file << std::endl;
+        std::cout << "label file: " << labels_file << std::endl;
+        std::abort();
+    }
+}
+
+//Remove the windows labeled as silence from the windows and from the labels
+void drop_sil(const std::string& samples_file, const std::string& labels_file, ana::window_arena& windows, std::vector<std::string>& labels){
+    check_labels(samples_file, labels_file, windows, labels);
+
+    std::size_t j = 0;
+
+    for(std::size_t i = 0; i < windows.windows(); ++i){
+        if(labels[i] != "sil"){
+            if(i != j){
+                std::memcpy(windows.window(j), windows.window(i), windows.window_size() * sizeof(float));
+                labels[j] = std::move(labels[i]);
+            }
+
+            ++j;
+        }
+    }
+
+    windows.truncate(j);
+    labels.erase(labels.begin() + j, labels.end());
+}
+
+//Return the position of the windows of each file after first, and the end position
+std::vector<std::size_t> scanned_offsets(std::size_t first, const std::vector<std::size_t>& windows){
+    std::vector<std::size_t> offsets(windows.size() + 1, first);
+    std::partial_sum(windows.begin(), windows.end(), offsets.begin() + 1);
+
+    for(std::size_t i = 1; i < offsets.size(); ++i){
+        offsets[i] += first;
+    }
+
+    return offsets;
+}
+
+//The windows must be at the place given by the scan
+void check_scanned(const std::string& file, std::size_t windows, std::size_t scanned){
+    if(windows != scanned){
+        std::cout << "\"" << file << "\" has changed since the scan" << std::endl;
+        std::cout << "   there are " << windows << " windows instead of " << scanned << std::endl;
+        std::abort();
+    }
+}
+
+} //end of anonymous namespace
+
+void ana::read_labels_str(const std::string& file, std::vector<std::string>& labels){
     if(verbose){
         std::cout << "Read labels from file \"" << file << "\"" << std::endl;
     }
@@ -67,8 +144,10 @@ void read_labels_str(const std::string& file, std::vector<std::string>& labels){
         std::cout << raw_labels.size() << " raw labels were read" << std::endl;
     }
 
-    for(std::size_t i = 0; i + N < raw_labels.size(); i += Stride){
-        labels.push_back(raw_labels[i + (N - 1) / 2]);
+    auto& shape = settings();
+
+    for(std::size_t i = 0; i + shape.n < raw_labels.size(); i += shape.stride){
+        labels.push_back(raw_labels[i + (shape.n - 1) / 2]);
     }
 
     if(verbose){
@@ -77,141 +156,171 @@ void read_labels_str(const std::string& file, std::vector<std::string>& labels){
 }
 
 void ana::read_labels(const std::string& file, std::vector<std::size_t>& labels){
+    if(memory_cache_bytes && memory_cache().load(file, labels)){
+        return;
+    }
+
     std::vector<std::string> str_labels;
     read_labels_str(file, str_labels);
 
+    if(memory_cache_bytes){
+        std::vector<std::size_t> file_labels;
+        map_labels(str_labels, file_labels);
+
+        memory_cache().store(file, file_labels);
+
+        labels.insert(labels.end(), file_labels.begin(), file_labels.end());
+    } else {
+        map_labels(str_labels, labels);
+    }
+}
+
+void ana::map_labels(const std::vector<std::string>& str_labels, std::vector<std::size_t>& labels){
+    auto& vocabulary = ana::vocabulary();
+
+    if(!vocabulary.frozen()){
+        std::cout << "The label vocabulary must be built and frozen before reading labels" << std::endl;
+        std::abort();
+    }
+
     for(auto& label : str_labels){
         if(!(drop_sil_windows && label == "sil")){
-            if(!mapper.count(label)){
-                auto new_label = mapper.size();
-                mapper[label] = new_label;
+            auto id = vocabulary.id(label);
+
+            if(id == label_vocabulary::npos){
+                std::cout << "The label \"" << label << "\" is not part of the vocabulary" << std::endl;
+                std::abort();
             }
 
-            labels.push_back(mapper[label]);
+            labels.push_back(id);
         }
     }
 }
 
-void ana::read_samples(const paired_files_t& files, const std::string& file, std::vector<ana::sample_t>& samples, bool pt){
+std::size_t ana::read_windows(const paired_files_t& files, const std::string& file, window_arena& windows, bool pt, bool cached){
     if(verbose){
         std::cout << "Read samples from file \"" << file << "\"" << std::endl;
     }
 
-    std::vector<ana::sample_t> tmp_samples;
-    std::vector<std::vector<float>> raw_samples;
-
-    std::ifstream infile(file);
-
-    std::string line;
-    while (std::getline(infile, line)){
-        std::vector<float> sample;
+    const bool dropped = !pt && drop_sil_windows;
+    const bool in_memory = cached && memory_cache_bytes;
 
-        std::istringstream iss(line);
-        float feature;
+    count(counter::FILES);
 
-        while(iss >> feature){
-            sample.push_back(feature);
-        }
+    std::size_t frames = 0;
+    if(in_memory && memory_cache().load(file, dropped, windows, frames)){
+        count(counter::FRAMES, frames);
+        count(counter::WINDOWS, windows.windows());
+        return frames;
+    }
 
-        //Don't take any chance
-        if(sample.size() != Features){
-            std::cout << "\"" << file << "\" has an incorrect number of feature" << std::endl;
-            std::cout << "   there are " << sample.size() << " features on one line" << std::endl;
-            std::abort();
+    if(cache_windows && ana::load_cached_windows(file, dropped, windows, frames)){
+        if(in_memory){
+            memory_cache().store(file, dropped, windows, frames);
         }
 
-        raw_samples.push_back(std::move(sample));
+        count(counter::FRAMES, frames);
+        count(counter::WINDOWS, windows.windows());
+        return frames;
     }
 
+    //The frames of each thread are reused from a file to the next
+    thread_local frames_t raw_samples;
+    read_frames(file, raw_samples);
+
     if(verbose){
-        std::cout << raw_samples.size() << " raw samples were read" << std::endl;
+        std::cout << raw_samples.rows << " raw samples were read" << std::endl;
     }
 
-    for(std::size_t i = 0; i < Features; ++i){
-        // Compute the mean
+    {
+        phase_timer timer(phase::NORMALIZE);
+        normalize_frames(file, raw_samples);
+    }
 
-        float mean = 0.0;
-        for(auto& sample : raw_samples){
-            mean += sample[i];
-        }
+    {
+        phase_timer timer(phase::WINDOWS);
+        assemble_windows(raw_samples, windows);
+    }
 
-        mean /= raw_samples.size();
+    if(dropped){
+        for(std::size_t i = 0; i < files.first.size(); ++i){
+            if(files.first[i] == file){
+                std::vector<std::string> labels;
+                read_labels_str(files.second[i], labels);
 
-        //Normalize to zero-mean
+                drop_sil(files.first[i], files.second[i], windows, labels);
 
-        for(auto& sample : raw_samples){
-            sample[i] -= mean;
+                break;
+            }
         }
+    }
 
-        //Compute the variance
+    if(cache_windows){
+        ana::store_cached_windows(file, dropped, windows, raw_samples.rows);
+    }
 
-        float std = 0.0;
-        for(auto& sample : raw_samples){
-            std += sample[i] * sample[i];
-        }
+    if(in_memory){
+        memory_cache().store(file, dropped, windows, raw_samples.rows);
+    }
 
-        std = std::sqrt(std / raw_samples.size());
+    if(verbose){
+        std::cout << windows.windows() << " window samples were read" << std::endl;
+    }
 
-        //Normalize to unit variance
+    count(counter::FRAMES, raw_samples.rows);
+    count(counter::WINDOWS, windows.windows());
 
-        if(std != 0.0){
-            for(auto& sample : raw_samples){
-                sample[i] /= std;
-            }
-        }
-    }
+    return raw_samples.rows;
+}
 
+std::size_t ana::read_samples(const paired_files_t& files, const std::string& file, std::vector<ana::sample_t>& samples, bool pt, bool cached){
+    //The arena of each thread is reused from a file to the next, it only allocates when it grows
+    thread_local window_arena windows;
 
-    for(std::size_t i = 0; i + N < raw_samples.size(); i += Stride){
-        ana::sample_t sample(Features * N);
+    auto frames = read_windows(files, file, windows, pt, cached);
 
-        std::size_t j = 0;
-        for(std::size_t x = 0; x < N; ++x){
-            for(auto& feature : raw_samples[i + x]){
-                sample[j++] = feature;
-            }
-        }
+    windows.append_to(samples);
 
-        tmp_samples.push_back(std::move(sample));
-    }
+    return frames;
+}
 
-    if(!pt && drop_sil_windows){
-        for(std::size_t i = 0; i < files.first.size(); ++i){
-            if(files.first[i] == file){
-                std::vector<std::string> labels;
-                read_labels_str(files.second[i], labels);
+void ana::read_utterance(const std::string& samples_file, const std::string& labels_file, utterance_t& utterance, bool cached){
+    const bool in_memory = cached && memory_cache_bytes;
 
-                if(labels.size() != tmp_samples.size()){
-                    std::cout << "Inconsistency between labels and samples windows" << std::endl;
-                    std::cout << "features file: " << files.first[i] << std::endl;
-                    std::cout << "label file: " << files.second[i] << std::endl;
-                    std::abort();
-                }
+    auto& windows = utterance.windows;
 
-                auto sit = tmp_samples.begin();
-                auto send = tmp_samples.end();
-                auto lit = labels.begin();
+    //The memory cache holds the windows without the silence and the labels, like for the sample and label iterators
 
-                while(sit != send){
-                    if(*lit == "sil"){
-                        sit = tmp_samples.erase(sit);
-                        send = tmp_samples.end();
-                    } else {
-                        ++sit;
-                    }
+    utterance.labels.clear();
 
-                    ++lit;
-                }
+    auto labels_cached = in_memory && memory_cache().load(labels_file, utterance.labels);
 
-                break;
-            }
-        }
+    if(labels_cached && memory_cache().load(samples_file, drop_sil_windows, windows, utterance.frames)){
+        return;
     }
 
-    std::move(tmp_samples.begin(), tmp_samples.end(), std::back_inserter(samples));
+    utterance.labels.clear();
 
-    if(verbose){
-        std::cout << samples.size() << " window samples were read" << std::endl;
+    std::vector<std::string> labels;
+    read_labels_str(labels_file, labels);
+
+    //The silence windows are dropped once the labels are known
+    utterance.frames = read_windows({}, samples_file, windows, true, false);
+
+    if(drop_sil_windows){
+        drop_sil(samples_file, labels_file, windows, labels);
+    } else {
+        check_labels(samples_file, labels_file, windows, labels);
+    }
+
+    map_labels(labels, utterance.labels);
+
+    if(in_memory){
+        memory_cache().store(samples_file, drop_sil_windows, windows, utterance.frames);
+
+        if(!labels_cached){
+            memory_cache().store(labels_file, utterance.labels);
+        }
     }
 }
 
@@ -223,82 +332,195 @@ ana::paired_files_t ana::get_paired_files(const std::string& ft_samples_file, co
     auto ft_samples_files = ana::get_files(ft_samples_file, feature_extension);
     auto ft_labels_files = ana::get_files(ft_labels_file, label_extension);
 
-    files_t samples_files;
-    files_t labels_files;
+    return pair_files(ft_samples_files, ft_labels_files);
+}
+
+ana::paired_files_t ana::pair_files(const files_t& samples_files, const files_t& labels_files){
+    std::vector<std::string> feature_extension{"feat"};
+    std::vector<std::string> label_extension{"framelab", "3phnlab"};
+
+    //Index the labels files by key, keeping the first file of each key
 
-    for(auto& s_file : ft_samples_files){
-        bool found = false;
+    std::unordered_map<std::string, std::size_t> exact_index;
+    std::unordered_map<std::string, std::size_t> parent_index;
 
-        for(auto& l_file : ft_labels_files){
-            auto clean_s = remove_extension(s_file, feature_extension);
-            auto clean_l = remove_extension(l_file, label_extension);
+    exact_index.reserve(labels_files.size());
+    parent_index.reserve(labels_files.size());
 
-            if(clean_l == clean_s){
-                samples_files.push_back(s_file);
-                labels_files.push_back(l_file);
+    for(std::size_t i = 0; i < labels_files.size(); ++i){
+        auto clean_l = remove_extension(labels_files[i], label_extension);
 
-                found = true;
-                break;
-            }
+        if(std::count(clean_l.begin(), clean_l.end(), '/') > 1){
+            parent_index.emplace(drop_parent(clean_l), i);
+        }
+
+        exact_index.emplace(std::move(clean_l), i);
+    }
 
-            if(std::count(clean_s.begin(), clean_s.end(), '/') > 1 && std::count(clean_l.begin(), clean_l.end(), '/') > 1){
-                auto last_s = clean_s.find_last_of('/');
-                auto last_l = clean_l.find_last_of('/');
+    files_t paired_samples_files;
+    files_t paired_labels_files;
 
-                auto prelast_s = clean_s.find_last_of('/', last_s - 1);
-                auto prelast_l = clean_l.find_last_of('/', last_l - 1);
+    for(auto& s_file : samples_files){
+        auto clean_s = remove_extension(s_file, feature_extension);
 
-                auto clean_clean_s =
-                    std::string(clean_s.begin(), clean_s.begin() + prelast_s + 1)
-                    +   std::string(clean_s.begin() + last_s, clean_s.end());
+        //The first labels file matching either key is the equivalent
 
-                auto clean_clean_l =
-                    std::string(clean_l.begin(), clean_l.begin() + prelast_l + 1)
-                    +   std::string(clean_l.begin() + last_l, clean_l.end());
+        auto match = labels_files.size();
 
-                if(clean_clean_l == clean_clean_s){
-                    samples_files.push_back(s_file);
-                    labels_files.push_back(l_file);
+        auto exact = exact_index.find(clean_s);
+        if(exact != exact_index.end()){
+            match = exact->second;
+        }
 
-                    found = true;
-                    break;
-                }
+        if(std::count(clean_s.begin(), clean_s.end(), '/') > 1){
+            auto parent = parent_index.find(drop_parent(clean_s));
+            if(parent != parent_index.end()){
+                match = std::min(match, parent->second);
             }
         }
 
-        if(!found){
+        if(match < labels_files.size()){
+            paired_samples_files.push_back(s_file);
+            paired_labels_files.push_back(labels_files[match]);
+        } else {
             std::cout << "No equivalent found for " << s_file << std::endl;
         }
     }
 
-    return {samples_files, labels_files};
+    return {paired_samples_files, paired_labels_files};
 }
 
 void ana::read_data(
     const std::string& pt_samples_file, const paired_files_t& ft_files,
     std::vector<sample_t>& pt_samples, std::vector<sample_t>& ft_samples, std::vector<std::size_t>& ft_labels,
-    bool lazy_pretraining, bool lazy_fine_tuning){
+    bool lazy_pretraining, bool lazy_fine_tuning, const data_scan* scan){
+
+    //The windows read at once are already held in memory, they do not go through the memory cache
 
     std::vector<std::string> feature_extension{"feat"};
 
-    //If not lazy, read the pretraining files
-    if(!lazy_pretraining){
+    //If not lazy and scanned, read the pretraining files directly at their place
+    if(!lazy_pretraining && scan){
         auto pt_samples_files = ana::get_files(pt_samples_file, feature_extension);
 
-        for(auto& file : pt_samples_files){
-            read_samples(ft_files, file, pt_samples, true);
+        auto start = clock_type::now();
+
+        auto offsets = scanned_offsets(pt_samples.size(), scan->pt_windows);
+
+        pt_samples.resize(offsets.back());
+
+        std::vector<std::size_t> file_frames(pt_samples_files.size());
+
+        parallel_foreach_i(pt_samples_files.size(), load_threads, [&](std::size_t i){
+            std::vector<sample_t> samples;
+            file_frames[i] = read_samples(ft_files, pt_samples_files[i], samples, true, false);
+
+            check_scanned(pt_samples_files[i], samples.size(), scan->pt_windows[i]);
+
+            std::move(samples.begin(), samples.end(), pt_samples.begin() + offsets[i]);
+        });
+
+        print_throughput("pretraining", pt_samples_files, std::accumulate(file_frames.begin(), file_frames.end(), std::size_t(0)), start);
+    } else if(!lazy_pretraining){
+        auto pt_samples_files = ana::get_files(pt_samples_file, feature_extension);
+
+        auto start = clock_type::now();
+
+        //Each file is read in its own slot and then appended in order
+        std::vector<std::vector<sample_t>> file_samples(pt_samples_files.size());
+        std::vector<std::size_t> file_frames(pt_samples_files.size());
+
+        parallel_foreach_i(pt_samples_files.size(), load_threads, [&](std::size_t i){
+            file_frames[i] = read_samples(ft_files, pt_samples_files[i], file_samples[i], true, false);
+        });
+
+        std::size_t windows = pt_samples.size();
+        for(auto& samples : file_samples){
+            windows += samples.size();
+        }
+
+        pt_samples.reserve(windows);
+
+        for(auto& samples : file_samples){
+            std::move(samples.begin(), samples.end(), std::back_inserter(pt_samples));
         }
+
+        print_throughput("pretraining", pt_samples_files, std::accumulate(file_frames.begin(), file_frames.end(), std::size_t(0)), start);
     }
 
-    //If not lazy, read the fine-tuning files
-    if(!lazy_fine_tuning){
-        for(auto& samples_file : ft_files.first){
-            read_samples(ft_files, samples_file, ft_samples, false);
+    //If not lazy and scanned, read the fine-tuning files directly at their place. When the <sil> windows are
+    //dropped, the number of windows is only known once the labels are read
+    if(!lazy_fine_tuning && scan && !drop_sil_windows){
+        auto start = clock_type::now();
+
+        auto sample_offsets = scanned_offsets(ft_samples.size(), scan->ft_windows);
+        auto label_offsets = scanned_offsets(ft_labels.size(), scan->ft_labels);
+
+        ft_samples.resize(sample_offsets.back());
+        ft_labels.resize(label_offsets.back());
+
+        std::vector<std::size_t> file_frames(ft_files.first.size());
+
+        parallel_foreach_i(ft_files.first.size(), load_threads, [&](std::size_t i){
+            //The utterance of each thread is reused from a file to the next
+            thread_local utterance_t utterance;
+            read_utterance(ft_files.first[i], ft_files.second[i], utterance, false);
+
+            check_scanned(ft_files.first[i], utterance.windows.windows(), scan->ft_windows[i]);
+            check_scanned(ft_files.second[i], utterance.labels.size(), scan->ft_labels[i]);
+
+            for(std::size_t w = 0; w < utterance.windows.windows(); ++w){
+                auto& sample = ft_samples[sample_offsets[i] + w];
+                sample = sample_t(utterance.windows.window_size());
+                utterance.windows.copy_window(w, sample);
+            }
+
+            std::copy(utterance.labels.begin(), utterance.labels.end(), ft_labels.begin() + label_offsets[i]);
+
+            file_frames[i] = utterance.frames;
+        });
+
+        auto files = ft_files.first;
+        files.insert(files.end(), ft_files.second.begin(), ft_files.second.end());
+
+        print_throughput("fine-tuning", files, std::accumulate(file_frames.begin(), file_frames.end(), std::size_t(0)), start);
+    } else if(!lazy_fine_tuning){
+        auto start = clock_type::now();
+
+        //Each file is read in its own slots and then appended in order
+        std::vector<std::vector<sample_t>> file_samples(ft_files.first.size());
+        std::vector<std::vector<label_t>> file_labels(ft_files.first.size());
+        std::vector<std::size_t> file_frames(ft_files.first.size());
+
+        parallel_foreach_i(ft_files.first.size(), load_threads, [&](std::size_t i){
+            //The utterance of each thread is reused from a file to the next
+            thread_local utterance_t utterance;
+            read_utterance(ft_files.first[i], ft_files.second[i], utterance, false);
+
+            utterance.windows.append_to(file_samples[i]);
+            file_labels[i] = utterance.labels;
+            file_frames[i] = utterance.frames;
+        });
+
+        std::size_t windows = ft_samples.size();
+        for(auto& samples : file_samples){
+            windows += samples.size();
         }
 
-        for(auto& labels_file : ft_files.second){
-            read_labels(labels_file, ft_labels);
+        auto frames = std::accumulate(file_frames.begin(), file_frames.end(), std::size_t(0));
+
+        ft_samples.reserve(windows);
+        ft_labels.reserve(windows);
+
+        for(std::size_t i = 0; i < file_samples.size(); ++i){
+            std::move(file_labels[i].begin(), file_labels[i].end(), std::back_inserter(ft_labels));
+            std::move(file_samples[i].begin(), file_samples[i].end(), std::back_inserter(ft_samples));
         }
+
+        auto files = ft_files.first;
+        files.insert(files.end(), ft_files.second.begin(), ft_files.second.end());
+
+        print_throughput("fine-tuning", files, frames, start);
     }
 
     std::cout << "A total of " << pt_samples.size() << " window samples were read for pretraining" << std::endl;
@@ -0,0 +1,263 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "config.hpp"
+#include "bnf.hpp"
+#include "features_writer.hpp"
+
+namespace {
+
+constexpr const int min_power = -64;
+constexpr const int max_power = 64;
+
+//The powers of ten as double, 10^k is at index k - min_power
+struct powers_t {
+    double values[max_power - min_power + 1];
+
+    powers_t(){
+        for(int k = min_power; k <= max_power; ++k){
+            values[k - min_power] = std::pow(10.0, k);
+        }
+    }
+
+    double operator()(int k) const {
+        return values[k - min_power];
+    }
+};
+
+const powers_t power10;
+
+constexpr const std::uint64_t integer_powers[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+//Write the digits of a value in the format of printf("%.*g", precision)
+std::size_t write_digits(char* out, std::uint64_t digits, int exponent, int precision){
+    char d[10];
+
+    for(int i = precision - 1; i >= 0; --i){
+        d[i] = '0' + digits % 10;
+        digits /= 10;
+    }
+
+    //Remove the trailing zeros
+    int n = precision;
+    while(n > 1 && d[n - 1] == '0'){
+        --n;
+    }
+
+    char* begin = out;
+
+    if(exponent < -4 || exponent >= precision){
+        *out++ = d[0];
+
+        if(n > 1){
+            *out++ = '.';
+            for(int i = 1; i < n; ++i){
+                *out++ = d[i];
+            }
+        }
+
+        *out++ = 'e';
+        *out++ = exponent < 0 ? '-' : '+';
+
+        int e = std::abs(exponent);
+
+        if(e >= 100){
+            *out++ = '0' + e / 100;
+        }
+
+        *out++ = '0' + (e / 10) % 10;
+        *out++ = '0' + e % 10;
+    } else if(exponent < 0){
+        *out++ = '0';
+        *out++ = '.';
+
+        for(int i = 0; i < -exponent - 1; ++i){
+            *out++ = '0';
+        }
+
+        for(int i = 0; i < n; ++i){
+            *out++ = d[i];
+        }
+    } else {
+        for(int i = 0; i < std::max(n, exponent + 1); ++i){
+            *out++ = i < n ? d[i] : '0';
+
+            if(i == exponent && i + 1 < n){
+                *out++ = '.';
+            }
+        }
+    }
+
+    return out - begin;
+}
+
+} //end of anonymous namespace
+
+std::size_t ana::format_float(float value, char* buffer){
+    if(!std::isfinite(value)){
+        return std::snprintf(buffer, 32, "%g", value);
+    }
+
+    char* out = buffer;
+
+    if(std::signbit(value)){
+        *out++ = '-';
+        value = -value;
+    }
+
+    if(value == 0.0f){
+        *out++ = '0';
+        return out - buffer;
+    }
+
+    double x = value;
+
+    //The decimal exponent, x is in [10^e, 10^(e+1))
+    int binary_exponent;
+    std::frexp(x, &binary_exponent);
+
+    int exponent = static_cast<int>(std::floor((binary_exponent - 1) * 0.30102999566398119521));
+
+    if(x >= power10(exponent + 1)){
+        ++exponent;
+    } else if(x < power10(exponent)){
+        --exponent;
+    }
+
+    //The decimal values in (low, high) read back to value. The bounds are
+    //exact in double, but the decimal values are not, so a small margin is
+    //kept to stay on the safe side of the bounds.
+    double low = x - (x - std::nextafter(value, 0.0f)) * 0.5;
+    double high = x + (std::nextafter(value, std::numeric_limits<float>::infinity()) - x) * 0.5;
+    double margin = x * 1e-14;
+
+    //A float always reads back from 9 significant digits, most of the values
+    //already read back from 6 or 7 digits
+
+    for(int precision = 6; precision <= 9; ++precision){
+        double scaled = x * power10(precision - 1 - exponent);
+        double integer = std::floor(scaled);
+
+        //Round half to even, like printf
+        auto digits = static_cast<std::uint64_t>(integer);
+        if(scaled - integer > 0.5 || (scaled - integer == 0.5 && (digits & 1))){
+            ++digits;
+        }
+
+        auto e = exponent;
+
+        if(digits >= integer_powers[precision]){
+            digits /= 10;
+            ++e;
+        }
+
+        double decimal = digits * power10(e - precision + 1);
+
+        if(precision == 9 || (decimal > low + margin && decimal < high - margin)){
+            out += write_digits(out, digits, e, precision);
+            break;
+        }
+
+        //Too close to a bound to decide, read it back
+        if(decimal >= low - margin && decimal <= high + margin){
+            auto length = write_digits(out, digits, e, precision);
+            out[length] = '\0';
+
+            if(std::strtof(out, nullptr) == value){
+                out += length;
+                break;
+            }
+        }
+    }
+
+    return out - buffer;
+}
+
+const char* ana::text_features_writer::extension() const {
+    return ".bnf";
+}
+
+void ana::text_features_writer::begin(std::string&) const {
+    //Nothing to do
+}
+
+void ana::text_features_writer::write(std::string& out, const float* values, std::size_t rows, std::size_t dims) const {
+    char buffer[32];
+
+    out.reserve(out.size() + rows * dims * 12);
+
+    for(std::size_t r = 0; r < rows; ++r){
+        for(std::size_t d = 0; d < dims; ++d){
+            auto length = format_float(values[r * dims + d], buffer);
+            buffer[length] = ',';
+            out.append(buffer, length + 1);
+        }
+
+        out.push_back('\n');
+    }
+}
+
+void ana::text_features_writer::end(std::string&, std::size_t, std::size_t, std::size_t) const {
+    //Nothing to do
+}
+
+const char* ana::binary_features_writer::extension() const {
+    return ".bnfb";
+}
+
+void ana::binary_features_writer::begin(std::string& out) const {
+    //The header is filled once the dimensions are known
+    out.append(sizeof(bnf_header), '\0');
+}
+
+void ana::binary_features_writer::write(std::string& out, const float* values, std::size_t rows, std::size_t dims) const {
+    auto n = rows * dims;
+
+    if(half){
+        auto position = out.size();
+        out.resize(position + n * sizeof(std::uint16_t));
+
+        for(std::size_t i = 0; i < n; ++i){
+            auto value = float_to_half(values[i]);
+            std::memcpy(&out[position + i * sizeof(value)], &value, sizeof(value));
+        }
+    } else {
+        out.append(reinterpret_cast<const char*>(values), n * sizeof(float));
+    }
+}
+
+void ana::binary_features_writer::end(std::string& out, std::size_t layer, std::size_t dims, std::size_t count) const {
+    bnf_header header;
+    std::memcpy(header.magic, bnf_magic, sizeof(bnf_magic));
+    header.version = bnf_version;
+    header.layer = layer;
+    header.dims = dims;
+    header.type = half ? bnf_float16 : bnf_float32;
+    header.count = count;
+
+    std::memcpy(&out[0], &header, sizeof(header));
+}
+
+const ana::features_writer& ana::configured_features_writer(){
+    static text_features_writer text_writer;
+    static binary_features_writer binary_writer(half_features);
+
+    if(binary_features){
+        return binary_writer;
+    } else {
+        return text_writer;
+    }
+}
@@ -0,0 +1,260 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cfloat>
+
+#include "frames.hpp"
+#include "settings.hpp"
+#include "telemetry.hpp"
+
+namespace {
+
+constexpr const std::size_t max_token = 64;
+
+const double powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+bool is_blank(char c){
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool is_digit(char c){
+    return c >= '0' && c <= '9';
+}
+
+//Slow path for everything the fast path cannot handle exactly (long mantissas,
+//large exponents, inf, nan, ...)
+const char* parse_float_slow(const char* it, const char* end, float& value){
+    char token[max_token];
+
+    std::size_t length = 0;
+    while(it + length != end && !is_blank(it[length]) && it[length] != '\n' && length < max_token - 1){
+        token[length] = it[length];
+        ++length;
+    }
+
+    token[length] = '\0';
+
+    char* token_end;
+    value = std::strtof(token, &token_end);
+
+    if(token_end == token){
+        return nullptr;
+    }
+
+    return it + (token_end - token);
+}
+
+/*!
+ * \brief Parse a float from [it, end) without going through the locale.
+ *
+ * The mantissa is accumulated as an integer and scaled by an exact power of
+ * ten in double precision before being rounded to float. Inputs that cannot
+ * be handled this way, or whose double is exactly halfway between two
+ * floats, are delegated to strtof, so the result is always the one of strtof.
+ *
+ * \return a pointer past the parsed characters or nullptr if there is no
+ * float at this position
+ */
+const char* parse_float(const char* it, const char* end, float& value){
+    const char* start = it;
+
+    bool negative = false;
+    if(it != end && (*it == '-' || *it == '+')){
+        negative = *it == '-';
+        ++it;
+    }
+
+    std::uint64_t mantissa = 0;
+    std::size_t digits = 0;
+    int exponent = 0;
+
+    while(it != end && is_digit(*it)){
+        mantissa = mantissa * 10 + (*it - '0');
+        ++digits;
+        ++it;
+    }
+
+    if(it != end && *it == '.'){
+        ++it;
+
+        while(it != end && is_digit(*it)){
+            mantissa = mantissa * 10 + (*it - '0');
+            ++digits;
+            --exponent;
+            ++it;
+        }
+    }
+
+    if(!digits){
+        return parse_float_slow(start, end, value);
+    }
+
+    if(it != end && (*it == 'e' || *it == 'E')){
+        ++it;
+
+        bool negative_exponent = false;
+        if(it != end && (*it == '-' || *it == '+')){
+            negative_exponent = *it == '-';
+            ++it;
+        }
+
+        if(it == end || !is_digit(*it)){
+            return parse_float_slow(start, end, value);
+        }
+
+        int e = 0;
+        while(it != end && is_digit(*it)){
+            if(e < 1000){
+                e = e * 10 + (*it - '0');
+            }
+            ++it;
+        }
+
+        exponent += negative_exponent ? -e : e;
+    }
+
+    //The mantissa must be exactly representable as a double
+    if(digits > 15 || exponent < -22 || exponent > 22){
+        return parse_float_slow(start, end, value);
+    }
+
+    double v = static_cast<double>(mantissa);
+
+    if(exponent < 0){
+        v /= powers_of_ten[-exponent];
+    } else {
+        v *= powers_of_ten[exponent];
+    }
+
+    //Rounding the double to float is a second rounding. It can only differ
+    //from a single rounding if the double is exactly halfway between two
+    //floats, in which case the decimal value may be on either side.
+    //Subnormal and overflowing floats are not rounded at the same position.
+
+    std::uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(v));
+
+    if(v != 0.0 && (v < FLT_MIN || v > FLT_MAX || (bits & 0x1FFFFFFF) == 0x10000000)){
+        return parse_float_slow(start, end, value);
+    }
+
+    value = static_cast<float>(negative ? -v : v);
+
+    return it;
+}
+
+bool read_file(const std::string& file, std::vector<char>& buffer){
+    auto fp = std::fopen(file.c_str(), "rb");
+
+    if(!fp){
+        buffer.clear();
+        return false;
+    }
+
+    std::fseek(fp, 0, SEEK_END);
+    auto size = std::ftell(fp);
+    std::fseek(fp, 0, SEEK_SET);
+
+    buffer.resize(size > 0 ? size : 0);
+
+    auto read = std::fread(buffer.data(), 1, buffer.size(), fp);
+    buffer.resize(read);
+
+    std::fclose(fp);
+
+    return true;
+}
+
+} //end of anonymous namespace
+
+void ana::read_frames(const std::string& file, frames_t& frames){
+    //The buffer is kept between calls to avoid allocations
+    thread_local std::vector<char> buffer;
+
+    phase_timer timer(phase::PARSE);
+
+    frames.rows = 0;
+    frames.columns = settings().features;
+
+    if(!read_file(file, buffer) || buffer.empty()){
+        frames.values.clear();
+        return;
+    }
+
+    count(counter::BYTES_READ, buffer.size());
+
+    const char* it = buffer.data();
+    const char* end = buffer.data() + buffer.size();
+
+    //Count the lines upfront to allocate the matrix once
+
+    std::size_t lines = 0;
+    const char* nl = it;
+    while((nl = static_cast<const char*>(std::memchr(nl, '\n', end - nl)))){
+        ++lines;
+        ++nl;
+    }
+
+    if(end[-1] != '\n'){
+        ++lines;
+    }
+
+    frames.values.resize(lines * frames.columns);
+
+    while(it != end){
+        float* row = frames.row(frames.rows);
+        std::size_t features = 0;
+
+        while(true){
+            while(it != end && is_blank(*it)){
+                ++it;
+            }
+
+            if(it == end || *it == '\n'){
+                break;
+            }
+
+            float feature;
+            auto next = parse_float(it, end, feature);
+
+            //Like a stream extraction, stop at the first invalid token
+            if(!next){
+                while(it != end && *it != '\n'){
+                    ++it;
+                }
+                break;
+            }
+
+            if(features < frames.columns){
+                row[features] = feature;
+            }
+
+            ++features;
+            it = next;
+        }
+
+        //Don't take any chance
+        if(features != frames.columns){
+            std::cout << "\"" << file << "\" has an incorrect number of feature" << std::endl;
+            std::cout << "   there are " << features << " features on one line" << std::endl;
+            std::abort();
+        }
+
+        ++frames.rows;
+
+        if(it != end){
+            ++it;
+        }
+    }
+}
@@ -7,14 +7,29 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <algorithm>
 
 #include <dirent.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
+#include "config.hpp"
 #include "io.hpp"
+#include "parallel.hpp"
+#include "telemetry.hpp"
 
 namespace {
 
+//Must be incremented each time the layout of the manifest changes
+constexpr const std::size_t manifest_version = 1;
+
 bool ends_with(const std::string& file, const std::vector<std::string>& extensions){
     for(auto& extension : extensions){
         auto extension_length = extension.size();
@@ -23,7 +38,7 @@ bool ends_with(const std::string& file, const std::vector<std::string>& extensio
             continue;
         }
 
-        if(std::string(file.begin() + file.size() - extension_length, file.end()) == extension){
+        if(file.compare(file.size() - extension_length, extension_length, extension) == 0){
             return true;
         }
     }
@@ -31,52 +46,406 @@ bool ends_with(const std::string& file, const std::vector<std::string>& extensio
     return false;
 }
 
-void handle(const std::string& file, std::vector<std::string>& files, const std::string& line, const std::vector<std::string>& extension){
-    struct stat buffer;
+//The modification time of a path, checked to know if a manifest is still valid
+struct mtime_t {
+    std::int64_t sec = 0;
+    std::int64_t nsec = 0;
 
-    if(stat(line.c_str(), &buffer) == 0){
-        if(S_ISDIR(buffer.st_mode)){
-            struct dirent* entry;
-            DIR* dp = opendir(line.c_str());
+    bool operator==(const mtime_t& rhs) const {
+        return sec == rhs.sec && nsec == rhs.nsec;
+    }
+};
 
-            if(dp){
-                while((entry = readdir(dp))){
-                    if(std::string(entry->d_name) == "." || std::string(entry->d_name) == ".."){
-                        continue;
-                    }
+mtime_t mtime(const struct stat& buffer){
+    mtime_t time;
+    time.sec = buffer.st_mtim.tv_sec;
+    time.nsec = buffer.st_mtim.tv_nsec;
+    return time;
+}
 
-                    handle(file, files, line + "/" + std::string(entry->d_name), extension);
-                }
+//An entry found under the line root of the list file
+using entry_t = std::pair<std::size_t, std::string>;
+
+/*!
+ * \brief The result of the scan of a list file.
+ *
+ * The files and the errors are sorted by line of the list file and then by
+ * path. The paths are all the paths whose modification changes the result:
+ * the list file, the directories and the files of the list.
+ */
+struct listing_t {
+    std::vector<std::string> files;
+    std::vector<std::string> errors;
+    std::vector<std::pair<std::string, mtime_t>> paths;
+};
+
+std::string invalid_entry(const std::string& file, int code, const std::string& line){
+    return "error: " + std::to_string(code) + ": The file \"" + file + "\" contains an invalid entry (\"" + line + "\")";
+}
+
+/*!
+ * \brief Walk the directories of a list file with several threads.
+ *
+ * Each thread takes a directory from the shared stack, reads its entries and
+ * pushes the sub directories back on the stack. The type of the entries is
+ * taken from readdir when the file system provides it, only the others are
+ * stat'ed.
+ */
+struct directory_walker {
+    const std::string& file;
+    const std::vector<std::string>& extensions;
+
+    std::vector<entry_t> files;
+    std::vector<entry_t> errors;
+    std::vector<std::pair<std::string, mtime_t>> paths;
+
+    directory_walker(const std::string& file, const std::vector<std::string>& extensions) : file(file), extensions(extensions) {}
+
+    //Handle an entry of the list file or of a directory, which can be of any type
+    void handle(std::size_t line, const std::string& path, std::vector<entry_t>& directories, std::vector<entry_t>& files, std::vector<entry_t>& errors){
+        struct stat buffer;
+
+        if(stat(path.c_str(), &buffer) == 0){
+            if(S_ISDIR(buffer.st_mode)){
+                directories.emplace_back(line, path);
+            } else if(S_ISREG(buffer.st_mode)){
+                handle_file(line, path, files, errors);
             } else {
-                printf("error: 1: The file \"%s\" contains an invalid entry (\"%s\")\n", file.c_str(), line.c_str());
+                errors.emplace_back(line, invalid_entry(file, 3, path));
+            }
+        } else {
+            errors.emplace_back(line, invalid_entry(file, 4, path));
+        }
+    }
+
+    void handle_file(std::size_t line, const std::string& path, std::vector<entry_t>& files, std::vector<entry_t>& errors){
+        if(ends_with(path, extensions)){
+            files.emplace_back(line, path);
+        } else if(!ends_with(path, {"bnf"})){
+            errors.emplace_back(line, invalid_entry(file, 2, path));
+        }
+    }
+
+    void scan(const entry_t& directory, std::vector<entry_t>& directories, std::vector<entry_t>& files, std::vector<entry_t>& errors, std::vector<std::pair<std::string, mtime_t>>& paths){
+        DIR* dp = opendir(directory.second.c_str());
+
+        if(!dp){
+            errors.emplace_back(directory.first, invalid_entry(file, 1, directory.second));
+            return;
+        }
+
+        struct stat buffer;
+        if(fstat(dirfd(dp), &buffer) == 0){
+            paths.emplace_back(directory.second, mtime(buffer));
+        }
+
+        std::string path;
+
+        struct dirent* entry;
+        while((entry = readdir(dp))){
+            auto name = entry->d_name;
+
+            if(name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))){
+                continue;
             }
-        } else if(S_ISREG(buffer.st_mode)){
-            if(ends_with(line, extension)){
-                files.push_back(line);
+
+            path.assign(directory.second);
+            path += '/';
+            path += name;
+
+            if(entry->d_type == DT_DIR){
+                directories.emplace_back(directory.first, path);
+            } else if(entry->d_type == DT_REG){
+                handle_file(directory.first, path, files, errors);
             } else {
-                if(!ends_with(line, {"bnf"})){
-                    printf("error: 2: The file \"%s\" contains an invalid entry (\"%s\")\n", file.c_str(), line.c_str());
+                //Unknown types and symbolic links need a stat
+                handle(directory.first, path, directories, files, errors);
+            }
+        }
+
+        closedir(dp);
+    }
+
+    void walk(std::vector<entry_t> roots, std::size_t threads){
+        std::mutex mutex;
+        std::condition_variable ready;
+
+        auto& stack = roots;
+        std::size_t busy = 0;
+
+        auto work = [&](){
+            std::vector<entry_t> local_directories;
+            std::vector<entry_t> local_files;
+            std::vector<entry_t> local_errors;
+            std::vector<std::pair<std::string, mtime_t>> local_paths;
+
+            std::unique_lock<std::mutex> lock(mutex);
+
+            while(true){
+                ready.wait(lock, [&]{ return !stack.empty() || !busy; });
+
+                if(stack.empty()){
+                    break;
                 }
+
+                auto directory = std::move(stack.back());
+                stack.pop_back();
+
+                ++busy;
+                lock.unlock();
+
+                scan(directory, local_directories, local_files, local_errors, local_paths);
+
+                lock.lock();
+                --busy;
+
+                std::move(local_directories.begin(), local_directories.end(), std::back_inserter(stack));
+                std::move(local_files.begin(), local_files.end(), std::back_inserter(files));
+                std::move(local_errors.begin(), local_errors.end(), std::back_inserter(errors));
+                std::move(local_paths.begin(), local_paths.end(), std::back_inserter(paths));
+
+                local_directories.clear();
+                local_files.clear();
+                local_errors.clear();
+                local_paths.clear();
+
+                ready.notify_all();
             }
-        } else {
-            printf("error: 3: The file \"%s\" contains an invalid entry (\"%s\")\n", file.c_str(), line.c_str());
+        };
+
+        std::vector<std::thread> pool;
+
+        for(std::size_t t = 1; t < ana::threads_count(threads); ++t){
+            pool.emplace_back(work);
         }
-    } else {
-        printf("error: 4: The file \"%s\" contains an invalid entry (\"%s\")\n", file.c_str(), line.c_str());
+
+        work();
+
+        for(auto& thread : pool){
+            thread.join();
+        }
+    }
+};
+
+std::vector<std::string> sorted_entries(std::vector<entry_t>& entries){
+    std::sort(entries.begin(), entries.end());
+
+    std::vector<std::string> sorted;
+    sorted.reserve(entries.size());
+
+    for(auto& entry : entries){
+        sorted.push_back(std::move(entry.second));
     }
+
+    return sorted;
 }
 
-} //end of anonymous namespace
+listing_t scan_list(const std::string& file, const std::vector<std::string>& extensions){
+    directory_walker walker(file, extensions);
 
-std::vector<std::string> ana::get_files(const std::string& file, const std::vector<std::string>& extension){
-    std::vector<std::string> files;
+    struct stat buffer;
+    if(stat(file.c_str(), &buffer) == 0){
+        walker.paths.emplace_back(file, mtime(buffer));
+    }
+
+    std::vector<entry_t> roots;
 
     std::ifstream istream(file);
 
     std::string line;
-    while(istream >> line){
-        handle(file, files, line, extension);
+    for(std::size_t i = 0; istream >> line; ++i){
+        auto files = walker.files.size();
+
+        walker.handle(i, line, roots, walker.files, walker.errors);
+
+        //A file of the list is part of the manifest, a directory is added when it is scanned
+        if(walker.files.size() > files && stat(line.c_str(), &buffer) == 0){
+            walker.paths.emplace_back(line, mtime(buffer));
+        }
+    }
+
+    walker.walk(std::move(roots), scan_threads);
+
+    listing_t listing;
+    listing.files = sorted_entries(walker.files);
+    listing.errors = sorted_entries(walker.errors);
+    listing.paths = std::move(walker.paths);
+
+    return listing;
+}
+
+std::string manifest_file(const std::string& file){
+    return file + ".manifest";
+}
+
+std::string join(const std::vector<std::string>& extensions){
+    std::string joined;
+
+    for(auto& extension : extensions){
+        joined += " " + extension;
+    }
+
+    return joined;
+}
+
+//Read a count line of the manifest and check its name
+bool read_count(std::istream& stream, const std::string& name, std::size_t& count){
+    std::string line;
+    if(!std::getline(stream, line)){
+        return false;
+    }
+
+    std::istringstream line_stream(line);
+
+    std::string key;
+    return (line_stream >> key >> count) && key == name;
+}
+
+//Read count lines of the manifest
+bool read_lines(std::istream& stream, const std::string& name, std::vector<std::string>& lines){
+    std::size_t count;
+    if(!read_count(stream, name, count)){
+        return false;
+    }
+
+    lines.resize(count);
+
+    for(auto& line : lines){
+        if(!std::getline(stream, line)){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*!
+ * \brief Load the listing from the manifest of the list file.
+ *
+ * The manifest is only used if all the paths it depends on still have the
+ * same modification time. Since adding or removing an entry changes the
+ * modification time of its directory, only the directories are checked,
+ * not the files.
+ */
+bool load_manifest(const std::string& file, const std::vector<std::string>& extensions, listing_t& listing){
+    std::ifstream stream(manifest_file(file));
+
+    if(!stream){
+        return false;
+    }
+
+    std::string line;
+    if(!std::getline(stream, line) || line != "ana-manifest " + std::to_string(manifest_version)){
+        return false;
+    }
+
+    if(!std::getline(stream, line) || line != "extensions" + join(extensions)){
+        return false;
+    }
+
+    std::size_t count;
+    if(!read_count(stream, "paths", count)){
+        return false;
+    }
+
+    for(std::size_t i = 0; i < count; ++i){
+        mtime_t time;
+        if(!(stream >> time.sec >> time.nsec) || stream.get() != ' ' || !std::getline(stream, line)){
+            return false;
+        }
+
+        struct stat buffer;
+        if(stat(line.c_str(), &buffer) != 0 || !(mtime(buffer) == time)){
+            return false;
+        }
+
+        listing.paths.emplace_back(line, time);
+    }
+
+    return read_lines(stream, "errors", listing.errors) && read_lines(stream, "files", listing.files);
+}
+
+void store_manifest(const std::string& file, const std::vector<std::string>& extensions, const listing_t& listing){
+    auto target = manifest_file(file);
+
+    //Write to a temporary file first so that a concurrent reader never sees a partial manifest
+    auto temp = target + ".tmp" + std::to_string(getpid());
+
+    {
+        std::ofstream stream(temp);
+
+        stream << "ana-manifest " << manifest_version << "\n";
+        stream << "extensions" << join(extensions) << "\n";
+
+        stream << "paths " << listing.paths.size() << "\n";
+        for(auto& path : listing.paths){
+            stream << path.second.sec << " " << path.second.nsec << " " << path.first << "\n";
+        }
+
+        stream << "errors " << listing.errors.size() << "\n";
+        for(auto& error : listing.errors){
+            stream << error << "\n";
+        }
+
+        stream << "files " << listing.files.size() << "\n";
+        for(auto& entry : listing.files){
+            stream << entry << "\n";
+        }
+
+        stream.close();
+
+        if(stream && std::rename(temp.c_str(), target.c_str()) == 0){
+            return;
+        }
+    }
+
+    std::cout << "Impossible to write the manifest file \"" << target << "\"" << std::endl;
+    std::remove(temp.c_str());
+}
+
+} //end of anonymous namespace
+
+std::vector<std::string> ana::get_files(const std::string& file, const std::vector<std::string>& extension){
+    //The same lists are needed several times by each action, they are only resolved once
+    static std::mutex mutex;
+    static std::map<std::pair<std::string, std::vector<std::string>>, std::vector<std::string>> resolved;
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    auto key = std::make_pair(file, extension);
+
+    auto it = resolved.find(key);
+    if(it != resolved.end()){
+        return it->second;
+    }
+
+    phase_timer timer(phase::GET_FILES);
+
+    listing_t listing;
+
+    bool loaded = file_manifest && load_manifest(file, extension, listing);
+
+    if(!loaded){
+        listing = scan_list(file, extension);
+    }
+
+    for(auto& error : listing.errors){
+        printf("%s\n", error.c_str());
+    }
+
+    if(file_manifest && !loaded){
+        store_manifest(file, extension, listing);
+    }
+
+    return resolved[key] = std::move(listing.files);
+}
+
+std::size_t ana::file_size(const std::string& file){
+    struct stat buffer;
+
+    if(stat(file.c_str(), &buffer) == 0){
+        return buffer.st_size;
     }
 
-    return files;
+    return 0;
 }
@@ -4,6 +4,10 @@
 //=======================================================================
 
 #include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <sstream>
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
@@ -24,13 +28,32 @@
 #include "data.hpp"
 #include "sample_iterator.hpp"
 #include "label_iterator.hpp"
+#include "shard.hpp"
+#include "prefetch_iterator.hpp"
+#include "paired_iterator.hpp"
+#include "shuffle_iterator.hpp"
+#include "vocabulary.hpp"
+#include "parallel.hpp"
+#include "bounded_queue.hpp"
+#include "batch.hpp"
+#include "features_writer.hpp"
+#include "normalization.hpp"
+#include "window_arena.hpp"
+#include "settings.hpp"
+#include "telemetry.hpp"
+#include "checkpoint.hpp"
+#include "training.hpp"
+#include "memory_cache.hpp"
+#include "scan.hpp"
 
 //0. Configure the DBN
 
-using dbn_t = dll::dbn_desc<dll::dbn_layers<
+//The DBN for windows of Input values
+template<std::size_t Input>
+using dbn_t = typename dll::dbn_desc<dll::dbn_layers<
         //First RBM
-          dll::rbm_desc<
-              Features * N              // Number of input features
+          typename dll::rbm_desc<
+              Input                     // Number of input features
             , 500                       // Number of hidden units
             , dll::momentum
             , dll::batch_size<50>
@@ -38,13 +61,13 @@ using dbn_t = dll::dbn_desc<dll::dbn_layers<
             , dll::visible<dll::unit_type::GAUSSIAN>
         >::rbm_t
         //Second RBM
-        , dll::rbm_desc<
+        , typename dll::rbm_desc<
             500, 200
             , dll::momentum             // Use momentum during training
             , dll::batch_size<50>
         >::rbm_t
         //Third RBM
-        , dll::rbm_desc<
+        , typename dll::rbm_desc<
             200
             , 42                        //This is the number of labels
             , dll::momentum
@@ -59,6 +82,22 @@ using dbn_t = dll::dbn_desc<dll::dbn_layers<
     , dll::weight_decay<>                       //Use L2 weight decay for SGD
     >::dbn_t;
 
+//The window shapes (N, Features) for which the DBN is compiled. Any window shape with the
+//same number of values as one of these shapes can be used without rebuilding
+template<std::size_t Frames, std::size_t FrameFeatures>
+struct window_shape {
+    static constexpr const std::size_t input = Frames * FrameFeatures;
+};
+
+template<typename... Shapes>
+struct shape_list {};
+
+using precompiled_shapes = shape_list<
+      window_shape<N, Features>  //The configured shape
+    , window_shape<7, Features>
+    , window_shape<15, Features>
+    >;
+
 namespace ana {
 
 template<typename DBN>
@@ -70,41 +109,25 @@ std::size_t count_distinct(std::vector<std::size_t> v){
 }
 
 template<typename DBN>
-void generate_features(DBN& dbn, const std::string& pt_samples_file, const std::string& ft_samples_file, const std::string& ft_labels_file);
+void generate_features(DBN& dbn, const std::string& pt_samples_file, const std::string& ft_samples_file, const std::string& ft_labels_file, std::size_t jobs);
 
 void mkdir_p(const char *path);
 
-} //end of ana namespace
-
-int main(int argc, char* argv[]){
-    if(argc < 5){
-        std::cout << "Not enough arguments" << std::endl;
-        return 1;
-    }
-
-    std::string action(argv[1]);
-    std::string pt_samples_file(argv[2]);
-    std::string ft_samples_file(argv[3]);
-    std::string ft_labels_file(argv[4]);
-
-    if(!(action == "train" || action == "feat" || action == "test" || action == "train_feat" || action == "train_test")){
-        std::cout << "Invalid action :" << action << std::endl;
-        return 2;
-    }
-
+template<typename DBN>
+int run(const std::string& action, const std::string& pt_samples_file, const std::string& ft_samples_file, const std::string& ft_labels_file){
     //1. Create the DBN
 
-    auto dbn = std::make_unique<dbn_t>();
+    auto dbn = std::make_unique<DBN>();
 
     //1.1 Configuration of the pretraining
 
-    //dbn->layer_get<0>().learning_rate *= 0.1;
-    //dbn->layer_get<0>().initial_momentum = 0.9;
-    //dbn->layer_get<0>().final_momentum = 0.9;
+    //dbn->template layer_get<0>().learning_rate *= 0.1;
+    //dbn->template layer_get<0>().initial_momentum = 0.9;
+    //dbn->template layer_get<0>().final_momentum = 0.9;
 
-    dbn->layer_get<1>().learning_rate = 0.05;
-    dbn->layer_get<1>().initial_momentum = 0.9;
-    dbn->layer_get<1>().final_momentum = 0.9;
+    dbn->template layer_get<1>().learning_rate = 0.05;
+    dbn->template layer_get<1>().initial_momentum = 0.9;
+    dbn->template layer_get<1>().final_momentum = 0.9;
     //...
 
     //1.2 Configuration of the fine-tuning
@@ -117,7 +140,52 @@ int main(int argc, char* argv[]){
     //Collect the paired files
     auto paired_files = ana::get_paired_files(ft_samples_file, ft_labels_file);
 
-    if(action == "train" || action == "train_feat" || action == "train_test"){
+    //Resume the training from the last checkpoint
+
+    ana::checkpoint_t checkpoint;
+
+    if(action == "resume"){
+        if(!ana::load_checkpoint(checkpoint_file, checkpoint)){
+            std::cout << "No valid checkpoint in \"" << checkpoint_file << "\"" << std::endl;
+            return 1;
+        }
+
+        if(checkpoint.input != settings().window_size()){
+            std::cout << "The checkpoint is for windows of " << checkpoint.input << " values, not " << settings().window_size() << std::endl;
+            return 1;
+        }
+
+        std::istringstream network(checkpoint.network);
+        dbn->load(network);
+
+        if(!network || network.peek() != std::char_traits<char>::eof()){
+            std::cout << "The network of the checkpoint does not match the configured network" << std::endl;
+            return 1;
+        }
+    }
+
+    //Build the label vocabulary, keeping the ids of the stored network when testing it
+
+    if(action != "feat" && action != "shard" && action != "stats"){
+        if(action == "test"){
+            if(!ana::vocabulary().load("file.dat.labels")){
+                std::cout << "Impossible to load the labels of the network from \"file.dat.labels\"" << std::endl;
+                return 1;
+            }
+        } else if(action == "resume"){
+            std::istringstream labels(checkpoint.labels);
+
+            if(!ana::vocabulary().load(labels)){
+                std::cout << "Impossible to load the labels of the checkpoint" << std::endl;
+                return 1;
+            }
+        }
+
+        ana::vocabulary().build(paired_files.second, load_threads);
+        ana::vocabulary().freeze();
+    }
+
+    if(action == "train" || action == "train_feat" || action == "train_test" || action == "resume"){
         //Collection of files for pretraining
         std::vector<std::string> feature_extension{"feat"};
         auto pt_samples_files = ana::get_files(pt_samples_file, feature_extension);
@@ -126,35 +194,179 @@ int main(int argc, char* argv[]){
         std::vector<ana::sample_t> ft_samples;       //The finetuning samples
         std::vector<std::size_t> ft_labels;          //The finetuning labels
 
-        ana::read_data(pt_samples_file, paired_files, pt_samples, ft_samples, ft_labels, lazy_pt, lazy_ft);
+        //With the automatic loading, the size of the data decides which phases are lazy
+
+        std::unique_ptr<ana::data_scan> scan;
+
+        if(auto_loading){
+            scan = std::make_unique<ana::data_scan>(ana::scan_data(pt_samples_files, paired_files, load_threads));
+            ana::choose_loading(*scan);
+        }
+
+        ana::read_data(pt_samples_file, paired_files, pt_samples, ft_samples, ft_labels, settings().lazy_pt, settings().lazy_ft, scan.get());
 
         std::cout << "There are " << ana::count_distinct(ft_labels) << " different labels" << std::endl;
 
+        //When checkpointing, with activation stores or with the parallel CD, the layers are pretrained one
+        //by one and, when checkpointing, the state of the training is saved
+
+        std::unique_ptr<ana::training_checkpoints> checkpoints;
+
+        if(checkpointing || activation_stores || parallel_cd || action == "resume"){
+            checkpoints = std::make_unique<ana::training_checkpoints>(checkpointing || action == "resume");
+
+            checkpoints->state.stage = checkpoint.stage;
+            checkpoints->state.layer = checkpoint.layer;
+            checkpoints->state.epoch = checkpoint.epoch;
+            checkpoints->state.shuffle_epoch = checkpoint.shuffle_epoch;
+            checkpoints->state.trainer = std::move(checkpoint.trainer);
+        }
+
         //3. Train the DBN layers for N epochs
 
         std::size_t pt_epochs = 10;
 
-        if(lazy_pt){
+        auto pretrain = [&](auto first, auto last){
+            if(checkpoints){
+                ana::pretrain_layers(*dbn, first, last, pt_epochs, *checkpoints);
+            } else {
+                dbn->pretrain(first, last, pt_epochs);
+            }
+        };
+
+        phase_timer pretraining_timer(phase::PRETRAINING);
+
+        if(settings().lazy_pt && use_shards){
+            ana::shard_t shard(pt_shard_file, pt_samples_files, files_t());
+
+            if(!shard.valid()){
+                return 1;
+            }
+
+            ana::shard_iterator it(shard);
+            ana::shard_iterator end(shard, shard.windows());
+
+            pretrain(it, end);
+        } else if(settings().lazy_pt && shuffle){
+            //Each layer continues the epochs of the previous layers, the checkpoints count the epochs drawn
+            auto first_epoch = checkpoints && checkpoints->state.stage == training_stage::PRETRAINING ? checkpoints->state.shuffle_epoch : 0;
+
+            auto source = std::make_shared<ana::shuffle_source>(pt_samples_files, files_t(), shuffle_seed, first_epoch);
+
+            ana::shuffle_sample_iterator it(source);
+            ana::shuffle_sample_iterator end(source, true);
+
+            if(checkpoints){
+                checkpoints->shuffle_epoch = [source]{ return source->epoch(0); };
+            }
+
+            pretrain(it, end);
+
+            if(checkpoints){
+                checkpoints->shuffle_epoch = nullptr;
+            }
+        } else if(settings().lazy_pt && prefetch){
+            ana::prefetch_sample_iterator it(paired_files, pt_samples_files, true);
+            ana::prefetch_sample_iterator end(paired_files, pt_samples_files, true, pt_samples_files.size());
+
+            pretrain(it, end);
+
+            ana::prefetch_stats().print("Pretraining prefetch");
+        } else if(settings().lazy_pt){
             ana::sample_iterator it(paired_files, pt_samples_files, true);
             ana::sample_iterator end(paired_files, pt_samples_files, true, pt_samples_files.size());
 
-            dbn->pretrain(it, end, pt_epochs);
+            pretrain(it, end);
+        } else if(checkpoints){
+            pretrain(pt_samples.begin(), pt_samples.end());
         } else {
             dbn->pretrain(pt_samples, pt_epochs);
         }
 
+        pretraining_timer.stop();
+
+        if(memory_cache_bytes){
+            ana::memory_cache().print("Pretraining memory cache");
+        }
+
         //4. Fine tune the DBN for M epochs
 
         std::size_t ft_epochs = 20;
 
-        if(lazy_ft){
-            ana::sample_iterator it(paired_files, pt_samples_files, false);
-            ana::sample_iterator end(paired_files, pt_samples_files, false, paired_files.first.size());
+        auto fine_tune = [&](auto first, auto last, auto lfirst, auto llast) -> double {
+            if(checkpoints && checkpoints->enabled()){
+                return ana::fine_tune_epochs(*dbn, first, last, lfirst, llast, ft_epochs, *checkpoints);
+            }
+
+            if(parallel_sgd){
+                return ana::parallel_fine_tune(*dbn, first, last, lfirst, llast, ft_epochs);
+            }
+
+            return dbn->fine_tune(first, last, lfirst, llast, ft_epochs);
+        };
+
+        phase_timer fine_tuning_timer(phase::FINE_TUNING);
+
+        if(settings().lazy_ft && use_shards){
+            ana::shard_t shard(ft_shard_file, paired_files.first, paired_files.second);
+
+            if(!shard.valid()){
+                return 1;
+            }
+
+            ana::shard_iterator it(shard);
+            ana::shard_iterator end(shard, shard.windows());
 
             ana::label_iterator lit(paired_files);
             ana::label_iterator lend(paired_files, paired_files.first.size());
 
-            auto ft_error = dbn->fine_tune(it, end, lit, lend, ft_epochs);
+            auto ft_error = fine_tune(it, end, lit, lend);
+
+            std::cout << "Fine-tuning error: " << ft_error << std::endl;
+        } else if(settings().lazy_ft && shuffle){
+            //The samples and the labels are drawn in the same order
+            auto first_epoch = checkpoints && checkpoints->state.stage == training_stage::FINE_TUNING ? checkpoints->state.shuffle_epoch : 0;
+
+            auto source = std::make_shared<ana::shuffle_source>(paired_files.first, paired_files.second, shuffle_seed, first_epoch);
+
+            ana::shuffle_sample_iterator it(source);
+            ana::shuffle_sample_iterator end(source, true);
+
+            ana::shuffle_label_iterator lit(source);
+            ana::shuffle_label_iterator lend(source, true);
+
+            if(checkpoints){
+                checkpoints->shuffle_epoch = [source]{ return source->epoch(0); };
+            }
+
+            auto ft_error = fine_tune(it, end, lit, lend);
+
+            if(checkpoints){
+                checkpoints->shuffle_epoch = nullptr;
+            }
+
+            std::cout << "Fine-tuning error: " << ft_error << std::endl;
+        } else if(settings().lazy_ft){
+            ana::prefetch_stats().reset();
+
+            //The samples and the labels are read together
+            auto source = std::make_shared<ana::paired_source>(paired_files);
+
+            ana::paired_sample_iterator it(source);
+            ana::paired_sample_iterator end(source, paired_files.first.size());
+
+            ana::paired_label_iterator lit(source);
+            ana::paired_label_iterator lend(source, paired_files.first.size());
+
+            auto ft_error = fine_tune(it, end, lit, lend);
+
+            std::cout << "Fine-tuning error: " << ft_error << std::endl;
+
+            if(prefetch){
+                ana::prefetch_stats().print("Fine-tuning prefetch");
+            }
+        } else if(checkpoints || parallel_sgd){
+            auto ft_error = fine_tune(ft_samples.begin(), ft_samples.end(), ft_labels.begin(), ft_labels.end());
 
             std::cout << "Fine-tuning error: " << ft_error << std::endl;
         } else {
@@ -163,21 +375,53 @@ int main(int argc, char* argv[]){
             std::cout << "Fine-tuning error: " << ft_error << std::endl;
         }
 
+        fine_tuning_timer.stop();
+
+        if(memory_cache_bytes){
+            ana::memory_cache().print("Fine-tuning memory cache");
+        }
+
         //5. Store the file if you want to save it for later
 
         dbn->store("file.dat"); //Store to file
+        ana::vocabulary().store("file.dat.labels");
 
         if(action == "train_feat"){
             std::cout << "Generate features" << std::endl;
-            ana::generate_features(*dbn, pt_samples_file, ft_samples_file, ft_labels_file);
+            ana::generate_features(*dbn, pt_samples_file, ft_samples_file, ft_labels_file, settings().jobs);
         } else if(action == "train_test"){
             ana::test(*dbn, paired_files, ft_samples, ft_labels);
         }
+    } else if(action == "shard"){
+        std::vector<std::string> feature_extension{"feat"};
+        auto pt_samples_files = ana::get_files(pt_samples_file, feature_extension);
+
+        if(!ana::write_shard(paired_files, pt_samples_files, true, pt_shard_file) || !ana::write_shard(paired_files, paired_files.first, false, ft_shard_file)){
+            return 1;
+        }
+    } else if(action == "stats"){
+        std::vector<std::string> feature_extension{"feat"};
+        auto files = ana::get_files(pt_samples_file, feature_extension);
+
+        for(auto& file : paired_files.first){
+            if(std::find(files.begin(), files.end(), file) == files.end()){
+                files.push_back(file);
+            }
+        }
+
+        auto stats = ana::compute_stats(files, load_threads);
+
+        std::cout << "Statistics of " << stats.global.count << " frames of " << stats.speakers.size() << " speakers" << std::endl;
+
+        if(!stats.store(stats_file)){
+            std::cout << "Impossible to write the statistics to \"" << stats_file << "\"" << std::endl;
+            return 1;
+        }
     } else if(action == "feat"){
         dbn->load("file.dat"); //Load from file
 
         std::cout << "Generate features" << std::endl;
-        ana::generate_features(*dbn, pt_samples_file, ft_samples_file, ft_labels_file);
+        ana::generate_features(*dbn, pt_samples_file, ft_samples_file, ft_labels_file, settings().jobs);
     } else if(action == "test"){
         dbn->load("file.dat"); //Load from file
 
@@ -185,7 +429,7 @@ int main(int argc, char* argv[]){
         std::vector<ana::sample_t> ft_samples;       //The finetuning samples
         std::vector<std::size_t> ft_labels;          //The finetuning labels
 
-        ana::read_data(pt_samples_file, paired_files, pt_samples, ft_samples, ft_labels, true, lazy_ft);
+        ana::read_data(pt_samples_file, paired_files, pt_samples, ft_samples, ft_labels, true, settings().lazy_ft);
 
         ana::test(*dbn, paired_files, ft_samples, ft_labels);
     }
@@ -193,37 +437,154 @@ int main(int argc, char* argv[]){
     return 0;
 }
 
+//Run the DBN compiled for the configured window size
+template<typename... Shapes>
+struct shape_dispatcher;
+
+template<>
+struct shape_dispatcher<shape_list<>> {
+    static int run(const std::string&, const std::string&, const std::string&, const std::string&){
+        auto& shape = settings();
+
+        std::cout << "The DBN is not compiled for windows of " << shape.n << " frames of " << shape.features << " features" << std::endl;
+        std::cout << "Add the shape to precompiled_shapes" << std::endl;
+
+        return 4;
+    }
+};
+
+template<typename Shape, typename... Shapes>
+struct shape_dispatcher<shape_list<Shape, Shapes...>> {
+    static int run(const std::string& action, const std::string& pt_samples_file, const std::string& ft_samples_file, const std::string& ft_labels_file){
+        if(settings().window_size() == Shape::input){
+            return ana::run<dbn_t<Shape::input>>(action, pt_samples_file, ft_samples_file, ft_labels_file);
+        }
+
+        return shape_dispatcher<shape_list<Shapes...>>::run(action, pt_samples_file, ft_samples_file, ft_labels_file);
+    }
+};
+
+} //end of ana namespace
+
+int main(int argc, char* argv[]){
+    if(argc < 5){
+        std::cout << "Not enough arguments" << std::endl;
+        return 1;
+    }
+
+    std::string action(argv[1]);
+    std::string pt_samples_file(argv[2]);
+    std::string ft_samples_file(argv[3]);
+    std::string ft_labels_file(argv[4]);
+
+    //The options override the settings of config.hpp (--config=file, --n=11, --jobs=4, ...)
+    if(!ana::settings().parse(argc, argv, 5)){
+        return 3;
+    }
+
+    if(!(action == "train" || action == "feat" || action == "test" || action == "train_feat" || action == "train_test" || action == "shard" || action == "stats" || action == "resume")){
+        std::cout << "Invalid action :" << action << std::endl;
+        return 2;
+    }
+
+    auto result = ana::shape_dispatcher<precompiled_shapes>::run(action, pt_samples_file, ft_samples_file, ft_labels_file);
+
+    if(telemetry_enabled){
+        ana::telemetry().report();
+    }
+
+    return result;
+}
+
 namespace ana {
 
+//A batch of windows for the batched inference
+struct test_batch {
+    std::vector<float> inputs;
+    std::vector<std::size_t> labels;
+};
+
+//The error counters of one inference thread
+struct test_counters {
+    std::vector<std::size_t> errors;
+    std::size_t errors_tot = 0;
+};
+
+template<typename DBN>
+void run_test_batch(DBN& dbn, batch_forward<DBN>& forward, const test_batch& batch, test_counters& counters){
+    forward.run(dbn, batch.inputs.data(), batch.labels.size());
+
+    for(std::size_t r = 0; r < batch.labels.size(); ++r){
+        auto p = forward.predict(r);
+        auto label = batch.labels[r];
+
+        //The counters are sized for the whole vocabulary
+        if(label >= counters.errors.size()){
+            std::cout << "The label " << label << " is not part of the vocabulary" << std::endl;
+            std::abort();
+        }
+
+        if(p != label){
+            ++counters.errors[label];
+            ++counters.errors_tot;
+        }
+    }
+}
+
 template<typename DBN>
 void test(DBN& dbn, paired_files_t& paired_files, std::vector<sample_t>& ft_samples, std::vector<std::size_t>& ft_labels){
     std::cout << "\nTest\n";
 
-    std::vector<std::string> pt_samples_files;
+    phase_timer timer(phase::TEST);
 
-    std::vector<std::size_t> errors;
-    std::size_t errors_tot = 0;
+    const std::size_t input_size = settings().window_size();
+
+    auto start = std::chrono::steady_clock::now();
+
+    auto threads = ana::threads_count(inference_threads);
+
+    //The error table has one line per label of the frozen vocabulary, in both modes
+
+    std::vector<test_counters> counters(threads);
     std::size_t total = 0;
 
-    if(lazy_ft){
-        ana::sample_iterator it(paired_files, pt_samples_files, false);
-        ana::sample_iterator end(paired_files, pt_samples_files, false, paired_files.first.size());
+    for(auto& c : counters){
+        c.errors.resize(ana::vocabulary().size());
+    }
 
-        ana::label_iterator lit(paired_files);
+    if(settings().lazy_ft){
+        //The windows are batched by this thread and the batches are evaluated by the workers
 
-        while(it != end){
-            auto& samples = *it;
-            auto& label = *lit;
+        ana::bounded_queue<test_batch> batches(2 * threads);
 
-            auto p = dbn.predict(samples);
+        std::vector<std::thread> workers;
+        for(std::size_t t = 0; t < threads; ++t){
+            workers.emplace_back([&dbn, &batches, &counters, t](){
+                batch_forward<DBN> forward;
+                test_batch batch;
 
-            if(p != label){
-                if(label >= errors.size()){
-                    errors.resize(label+1);
+                while(batches.pop(batch)){
+                    run_test_batch(dbn, forward, batch, counters[t]);
                 }
+            });
+        }
+
+        auto source = std::make_shared<ana::paired_source>(paired_files);
+
+        ana::paired_sample_iterator it(source);
+        ana::paired_sample_iterator end(source, paired_files.first.size());
+
+        ana::paired_label_iterator lit(source);
+
+        test_batch batch;
 
-                ++errors[label];
-                ++errors_tot;
+        while(it != end){
+            batch.inputs.insert(batch.inputs.end(), it->begin(), it->end());
+            batch.labels.push_back(*lit);
+
+            if(batch.labels.size() == inference_batch){
+                batches.push(std::move(batch));
+                batch = test_batch();
             }
 
             ++total;
@@ -231,43 +592,71 @@ void test(DBN& dbn, paired_files_t& paired_files, std::vector<sample_t>& ft_samp
             ++it;
             ++lit;
         }
+
+        if(!batch.labels.empty()){
+            batches.push(std::move(batch));
+        }
+
+        batches.close();
+
+        for(auto& worker : workers){
+            worker.join();
+        }
     } else {
         total = ft_samples.size();
 
-        auto labels = ana::count_distinct(ft_labels);
-        errors.resize(labels);
+        auto n_batches = (total + inference_batch - 1) / inference_batch;
 
-        for(std::size_t i = 0; i < ft_samples.size(); ++i){
-            auto& samples = ft_samples[i];
-            auto& label = ft_labels[i];
+        ana::parallel_foreach_i(threads, threads, [&](std::size_t t){
+            batch_forward<DBN> forward;
+            test_batch batch;
 
-            auto p = dbn.predict(samples);
+            for(std::size_t b = t; b < n_batches; b += threads){
+                auto first = b * inference_batch;
+                auto last = std::min(first + inference_batch, total);
 
-            if(p != label){
-                ++errors[label];
-                ++errors_tot;
+                batch.inputs.resize((last - first) * input_size);
+                batch.labels.assign(ft_labels.begin() + first, ft_labels.begin() + last);
+
+                for(std::size_t i = first; i < last; ++i){
+                    std::copy(ft_samples[i].begin(), ft_samples[i].end(), batch.inputs.begin() + (i - first) * input_size);
+                }
+
+                run_test_batch(dbn, forward, batch, counters[t]);
             }
+        });
+    }
+
+    //Merge the counters of the threads
+
+    std::vector<std::size_t> errors(ana::vocabulary().size());
+    std::size_t errors_tot = 0;
+
+    for(auto& c : counters){
+        for(std::size_t i = 0; i < c.errors.size(); ++i){
+            errors[i] += c.errors[i];
         }
+
+        errors_tot += c.errors_tot;
     }
 
+    auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Evaluated " << total << " windows in " << seconds << "s (" << total / seconds << " windows/s)" << std::endl;
+
     std::cout << "Accuracy: " << (total - errors_tot) / double(total) << std::endl;;
     std::cout << "Errors: " << errors_tot << std::endl;;
 
-    auto rmap = ana::reverse_mapper();
+    auto& vocabulary = ana::vocabulary();
 
     for(std::size_t i = 0; i < errors.size(); ++i){
-        std::cout << rmap[i] << " " << errors[i] << std::endl;
+        std::cout << vocabulary.name(i) << " " << errors[i] << std::endl;
     }
 }
 
-template<std::size_t I, typename DBN, cpp_enable_if((I == DBN::layers))>
-void generate_features_layer(DBN&, const std::vector<ana::sample_t>&, const std::string&){
-    //Cool
-}
-
-template<std::size_t I, typename DBN, cpp_enable_if((I < DBN::layers))>
-void generate_features_layer(DBN& dbn, const std::vector<ana::sample_t>& samples, const std::string& file){
-    std::string target_file = std::string(file.begin(), file.end() - 4) + std::to_string(I) + ".bnf";
+//Return the features file of the given layer, creating its directory if necessary
+std::string features_file(const std::string& file, std::size_t I, const char* extension){
+    std::string target_file = std::string(file.begin(), file.end() - 4) + std::to_string(I) + extension;
 
     auto b = target_file.find(features_replace_source);
     if(b != std::string::npos){
@@ -277,31 +666,105 @@ void generate_features_layer(DBN& dbn, const std::vector<ana::sample_t>& samples
         mkdir_p(directory.c_str());
     }
 
-    std::ofstream out(target_file);
+    return target_file;
+}
 
-    if(!out.is_open()){
-        std::cout << target_file << " not ok" << std::endl;
+/*!
+ * \brief Compute the features of all the layers for the windows of a file
+ * and encode them in one buffer per layer.
+ *
+ * Each batch of windows goes through the network once and the activations
+ * of every layer are encoded from this single forward pass.
+ */
+template<typename DBN>
+void compute_features(DBN& dbn, batch_forward<DBN>& forward, const features_writer& writer, const window_arena& windows, std::vector<std::string>& outputs){
+    outputs.resize(DBN::layers);
+
+    std::size_t dims[DBN::layers] = {};
+
+    for(std::size_t I = 0; I < DBN::layers; ++I){
+        outputs[I].clear();
+        writer.begin(outputs[I]);
     }
 
-    for(auto& sample : samples){
-        auto features = dbn.template activation_probabilities_sub<I>(sample);
+    //The windows of the arena are directly the input matrix of the batches
+
+    for(std::size_t first = 0; first < windows.windows(); first += inference_batch){
+        auto rows = std::min(inference_batch, windows.windows() - first);
+
+        forward.run(dbn, windows.window(first), rows);
 
-        for(auto& feature : features){
-            out <<  feature << ",";
+        for(std::size_t I = 0; I < DBN::layers; ++I){
+            dims[I] = forward.activations[I].size() / rows;
+            writer.write(outputs[I], forward.activation(I, 0), rows, dims[I]);
         }
+    }
 
-        out << '\n';
+    for(std::size_t I = 0; I < DBN::layers; ++I){
+        writer.end(outputs[I], I, dims[I], windows.windows());
     }
+}
 
-    std::cout << '.';
-    std::cout.flush();
+//Write the encoded features of all the layers of a file
+void write_features(const features_writer& writer, const std::string& file, const std::vector<std::string>& outputs){
+    phase_timer timer(phase::WRITE_FEATURES);
+
+    for(std::size_t I = 0; I < outputs.size(); ++I){
+        auto target_file = features_file(file, I, writer.extension());
+
+        std::ofstream out(target_file, std::ios::binary);
+
+        if(!out.is_open()){
+            std::cout << target_file << " not ok" << std::endl;
+        }
+
+        out.write(outputs[I].data(), outputs[I].size());
+
+        count(counter::BYTES_WRITTEN, outputs[I].size());
+
+        std::cout << '.';
+    }
 
-    //Generate features for the next layer
-    generate_features_layer<I+1>(dbn, samples, file);
+    std::cout.flush();
 }
 
+//A file going through the stages of the feature generation
+struct feature_job {
+    std::string file;
+    window_arena windows;
+    std::vector<std::string> outputs;
+};
+
+//The time spent by all the threads of a stage
+struct stage_timer {
+    std::atomic<std::size_t> us;
+
+    stage_timer() : us(0) {}
+
+    template<typename Functor>
+    void time(Functor&& functor){
+        auto start = std::chrono::steady_clock::now();
+        functor();
+        auto end = std::chrono::steady_clock::now();
+        us += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    }
+
+    void print(const std::string& stage) const {
+        std::cout << "   " << stage << ": " << us / 1000 << "ms" << std::endl;
+    }
+};
+
+/*!
+ * \brief Generate the features of the pretraining and fine-tuning files.
+ *
+ * The files go through a pipeline of reader, compute and writer threads
+ * connected by bounded queues. The compute threads share the network, which
+ * is only read, and each have their own activation buffers.
+ */
 template<typename DBN>
-void generate_features(DBN& dbn, const std::string& pt_samples_file, const std::string& ft_samples_file, const std::string& ft_labels_file){
+void generate_features(DBN& dbn, const std::string& pt_samples_file, const std::string& ft_samples_file, const std::string& ft_labels_file, std::size_t jobs){
+    phase_timer timer(phase::FEATURES);
+
     std::vector<std::string> feature_extension{"feat"};
     std::vector<std::string> label_extension{"framelab", "3phnlab"};
 
@@ -309,19 +772,83 @@ void generate_features(DBN& dbn, const std::string& pt_samples_file, const std::
 
     auto paired_files = ana::get_paired_files(ft_samples_file, ft_labels_file);
 
-    for(auto& file : pt_samples_files){
-        std::vector<ana::sample_t> samples;
-        ana::read_samples(paired_files, file, samples, true);
+    std::vector<std::string> files(pt_samples_files);
+    files.insert(files.end(), paired_files.first.begin(), paired_files.first.end());
+
+    jobs = threads_count(jobs);
+
+    auto& writer = configured_features_writer();
+
+    stage_timer read_timer;
+    stage_timer compute_timer;
+    stage_timer write_timer;
+
+    bounded_queue<feature_job> read_queue(2 * jobs);
+    bounded_queue<feature_job> write_queue(2 * jobs);
+
+    std::atomic<std::size_t> next_file(0);
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> readers;
+    std::vector<std::thread> computers;
+
+    for(std::size_t t = 0; t < jobs; ++t){
+        readers.emplace_back([&](){
+            std::size_t i;
+            while((i = next_file++) < files.size()){
+                feature_job job;
+                job.file = files[i];
+
+                read_timer.time([&](){ ana::read_windows(paired_files, job.file, job.windows, true); });
 
-        generate_features_layer<0>(dbn, samples, file);
+                read_queue.push(std::move(job));
+            }
+        });
+
+        computers.emplace_back([&](){
+            batch_forward<DBN> forward;
+            feature_job job;
+
+            while(read_queue.pop(job)){
+                compute_timer.time([&](){ compute_features(dbn, forward, writer, job.windows, job.outputs); });
+
+                job.windows = window_arena();
+
+                write_queue.push(std::move(job));
+            }
+        });
+    }
+
+    std::thread writer_thread([&](){
+        feature_job job;
+
+        while(write_queue.pop(job)){
+            write_timer.time([&](){ write_features(writer, job.file, job.outputs); });
+        }
+    });
+
+    for(auto& thread : readers){
+        thread.join();
     }
 
-    for(auto& file : paired_files.first){
-        std::vector<ana::sample_t> samples;
-        ana::read_samples(paired_files, file, samples, true);
+    read_queue.close();
 
-        generate_features_layer<0>(dbn, samples, file);
+    for(auto& thread : computers){
+        thread.join();
     }
+
+    write_queue.close();
+    writer_thread.join();
+
+    auto end = std::chrono::steady_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+    std::cout << std::endl;
+    std::cout << "Features of " << files.size() << " files generated in " << duration << "ms with " << jobs << " jobs" << std::endl;
+    read_timer.print("read");
+    compute_timer.print("compute");
+    write_timer.print("write");
 }
 
 void mkdir_p(const char *path){
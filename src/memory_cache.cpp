@@ -0,0 +1,212 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <iostream>
+#include <algorithm>
+
+#include "memory_cache.hpp"
+#include "window_arena.hpp"
+#include "telemetry.hpp"
+#include "settings.hpp"
+
+namespace {
+
+std::string samples_key(const std::string& file, bool dropped){
+    return (dropped ? "samples-dropped:" : "samples:") + file;
+}
+
+std::string labels_key(const std::string& file){
+    return "labels:" + file;
+}
+
+} //end of anonymous namespace
+
+ana::memory_cache_t::memory_cache_t(std::size_t capacity) : hits(0), misses(0), evictions(0), rejections(0), capacity(capacity) {
+    //Nothing else to init
+}
+
+ana::memory_cache_t::entry_ptr ana::memory_cache_t::find(const std::string& key){
+    std::unique_lock<std::mutex> lock(mutex);
+
+    ++frequencies[key];
+
+    //Halve the frequencies once each file has been read 16 times on average
+    if(++reads >= 16 * frequencies.size()){
+        for(auto it = frequencies.begin(); it != frequencies.end();){
+            if((it->second /= 2) == 0 && !index.count(it->first)){
+                it = frequencies.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        reads = 0;
+    }
+
+    auto it = index.find(key);
+
+    if(it == index.end()){
+        ++misses;
+        count(counter::CACHE_MISSES);
+        return nullptr;
+    }
+
+    //Move the entry at the front
+    entries.splice(entries.begin(), entries, it->second);
+
+    ++hits;
+    count(counter::CACHE_HITS);
+
+    return *it->second;
+}
+
+bool ana::memory_cache_t::admit(const std::string& key, std::size_t bytes, std::list<entry_ptr>::iterator& victims){
+    if(bytes > capacity){
+        return false;
+    }
+
+    //The least recently used entries are only evicted if they are read less often than the new one
+
+    auto frequency = frequencies[key];
+
+    auto free = capacity - used;
+    victims = entries.end();
+
+    while(free < bytes){
+        --victims;
+
+        if(frequencies[(*victims)->key] >= frequency){
+            return false;
+        }
+
+        free += (*victims)->bytes();
+    }
+
+    return true;
+}
+
+bool ana::memory_cache_t::admissible(const std::string& key, std::size_t bytes){
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if(index.count(key)){
+        return false;
+    }
+
+    auto victims = entries.end();
+
+    if(!admit(key, bytes, victims)){
+        ++rejections;
+        return false;
+    }
+
+    return true;
+}
+
+void ana::memory_cache_t::insert(entry_ptr entry){
+    std::unique_lock<std::mutex> lock(mutex);
+
+    //Another thread may have stored the same file
+    if(index.count(entry->key)){
+        return;
+    }
+
+    auto bytes = entry->bytes();
+    auto victims = entries.end();
+
+    //The cache may have changed since the entry was admitted
+    if(!admit(entry->key, bytes, victims)){
+        ++rejections;
+        return;
+    }
+
+    while(victims != entries.end()){
+        used -= (*victims)->bytes();
+        index.erase((*victims)->key);
+        victims = entries.erase(victims);
+
+        ++evictions;
+        count(counter::CACHE_EVICTIONS);
+    }
+
+    used += bytes;
+    entries.push_front(std::move(entry));
+    index[entries.front()->key] = entries.begin();
+}
+
+bool ana::memory_cache_t::load(const std::string& file, bool dropped, window_arena& windows, std::size_t& frames){
+    auto entry = find(samples_key(file, dropped));
+
+    if(!entry){
+        return false;
+    }
+
+    windows.resize(entry->windows.size() / settings().window_size());
+    std::copy(entry->windows.begin(), entry->windows.end(), windows.data());
+
+    frames = entry->frames;
+
+    return true;
+}
+
+void ana::memory_cache_t::store(const std::string& file, bool dropped, const window_arena& windows, std::size_t frames){
+    auto key = samples_key(file, dropped);
+
+    //The windows are only copied if they are admitted
+    if(!admissible(key, key.size() + windows.windows() * windows.window_size() * sizeof(float))){
+        return;
+    }
+
+    auto entry = std::make_shared<entry_t>();
+
+    entry->key = std::move(key);
+    entry->windows.assign(windows.data(), windows.data() + windows.windows() * windows.window_size());
+    entry->frames = frames;
+
+    insert(std::move(entry));
+}
+
+bool ana::memory_cache_t::load(const std::string& file, std::vector<std::size_t>& labels){
+    auto entry = find(labels_key(file));
+
+    if(!entry){
+        return false;
+    }
+
+    labels.insert(labels.end(), entry->labels.begin(), entry->labels.end());
+
+    return true;
+}
+
+void ana::memory_cache_t::store(const std::string& file, const std::vector<std::size_t>& labels){
+    auto key = labels_key(file);
+
+    if(!admissible(key, key.size() + labels.size() * sizeof(std::size_t))){
+        return;
+    }
+
+    auto entry = std::make_shared<entry_t>();
+
+    entry->key = std::move(key);
+    entry->labels = labels;
+
+    insert(std::move(entry));
+}
+
+std::size_t ana::memory_cache_t::size(){
+    std::unique_lock<std::mutex> lock(mutex);
+    return used;
+}
+
+void ana::memory_cache_t::print(const std::string& phase){
+    std::cout << phase << ": " << hits << " hits, " << misses << " misses, " << evictions << " evictions, "
+        << rejections << " rejections, " << size() / (1024 * 1024) << "MB of " << capacity / (1024 * 1024) << "MB used" << std::endl;
+}
+
+ana::memory_cache_t& ana::memory_cache(){
+    static memory_cache_t cache(memory_cache_bytes);
+    return cache;
+}
@@ -0,0 +1,339 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "normalization.hpp"
+#include "frames.hpp"
+#include "parallel.hpp"
+#include "settings.hpp"
+
+namespace {
+
+constexpr const char* stats_magic = "ana-stats";
+
+//Must be incremented each time the layout of the stats file changes
+constexpr const std::size_t stats_version = 2;
+
+const ana::stats_table& loaded_stats(){
+    static ana::stats_table stats = [](){
+        ana::stats_table table;
+
+        if(!table.load(stats_file)){
+            std::cout << "Impossible to load the normalization statistics from \"" << stats_file << "\"" << std::endl;
+            std::cout << "They can be computed with the stats action" << std::endl;
+            std::abort();
+        }
+
+        return table;
+    }();
+
+    return stats;
+}
+
+const ana::feature_stats& file_stats(const std::string& file){
+    auto& stats = loaded_stats();
+
+    if(normalization == normalization_mode::SPEAKER){
+        auto it = stats.speakers.find(ana::speaker(file));
+
+        if(it == stats.speakers.end()){
+            std::cout << "No normalization statistics for the speaker of " << file << std::endl;
+            std::abort();
+        }
+
+        return it->second;
+    }
+
+    return stats.global;
+}
+
+//The key is a directory, it is alone on its line since it may contain spaces
+void write_stats(std::ostream& out, const std::string& key, const ana::feature_stats& stats){
+    out << key << '\n' << stats.count;
+
+    for(auto mean : stats.mean){
+        out << ' ' << mean;
+    }
+
+    for(auto m2 : stats.m2){
+        out << ' ' << m2;
+    }
+
+    out << '\n';
+}
+
+bool read_stats(std::istream& in, std::string& key, ana::feature_stats& stats){
+    if(!std::getline(in >> std::ws, key) || !(in >> stats.count)){
+        return false;
+    }
+
+    for(auto& mean : stats.mean){
+        in >> mean;
+    }
+
+    for(auto& m2 : stats.m2){
+        in >> m2;
+    }
+
+    return static_cast<bool>(in);
+}
+
+/*
+ * The kernels are instantiated with F = Features, the configured number of
+ * features, for which the inner loop is fully unrolled, and with F = 0 for
+ * any other number of features.
+ */
+
+template<std::size_t F>
+void sums_kernel(const ana::frames_t& frames, const double* shift, double* s1, double* s2){
+    const std::size_t features = F ? F : frames.columns;
+
+    for(std::size_t r = 0; r < frames.rows; ++r){
+        auto row = frames.row(r);
+
+        for(std::size_t i = 0; i < features; ++i){
+            double d = row[i] - shift[i];
+            s1[i] += d;
+            s2[i] += d * d;
+        }
+    }
+}
+
+template<std::size_t F>
+void apply_kernel(ana::frames_t& frames, const float* mean, const float* scale){
+    const std::size_t features = F ? F : frames.columns;
+
+    //The features of a row are contiguous, the inner loop is vectorized
+    for(std::size_t r = 0; r < frames.rows; ++r){
+        auto row = frames.row(r);
+
+        for(std::size_t i = 0; i < features; ++i){
+            row[i] = (row[i] - mean[i]) * scale[i];
+        }
+    }
+}
+
+} //end of anonymous namespace
+
+ana::feature_stats::feature_stats() : mean(settings().features), m2(settings().features) {
+    //Nothing else to init
+}
+
+void ana::feature_stats::add(const frames_t& frames){
+    if(!frames.rows){
+        return;
+    }
+
+    //The sums are shifted by the first frame to avoid cancellation
+
+    const std::size_t features = frames.columns;
+
+    std::vector<double> shift(frames.row(0), frames.row(1));
+    std::vector<double> s1(features);
+    std::vector<double> s2(features);
+
+    if(features == Features){
+        sums_kernel<Features>(frames, shift.data(), s1.data(), s2.data());
+    } else {
+        sums_kernel<0>(frames, shift.data(), s1.data(), s2.data());
+    }
+
+    feature_stats batch;
+    batch.count = frames.rows;
+
+    for(std::size_t i = 0; i < features; ++i){
+        batch.mean[i] = shift[i] + s1[i] / frames.rows;
+        batch.m2[i] = std::max(0.0, s2[i] - s1[i] * s1[i] / frames.rows);
+    }
+
+    merge(batch);
+}
+
+void ana::feature_stats::merge(const feature_stats& other){
+    if(!other.count){
+        return;
+    }
+
+    if(!count){
+        *this = other;
+        return;
+    }
+
+    double n = count + other.count;
+
+    for(std::size_t i = 0; i < mean.size(); ++i){
+        double delta = other.mean[i] - mean[i];
+        mean[i] += delta * other.count / n;
+        m2[i] += other.m2[i] + delta * delta * count * other.count / n;
+    }
+
+    count += other.count;
+}
+
+ana::normalization_t::normalization_t(const feature_stats& stats) : mean(stats.mean.size()), scale(stats.mean.size()) {
+    for(std::size_t i = 0; i < mean.size(); ++i){
+        auto deviation = stats.count ? std::sqrt(stats.m2[i] / stats.count) : 0.0;
+
+        mean[i] = stats.mean[i];
+        scale[i] = deviation != 0.0 ? 1.0 / deviation : 1.0;
+    }
+}
+
+void ana::normalization_t::apply(frames_t& frames) const {
+    if(frames.columns == Features){
+        apply_kernel<Features>(frames, mean.data(), scale.data());
+    } else {
+        apply_kernel<0>(frames, mean.data(), scale.data());
+    }
+}
+
+bool ana::stats_table::store(const std::string& file) const {
+    std::ofstream out(file);
+
+    out.precision(17);
+
+    out << stats_magic << ' ' << stats_version << ' ' << global.mean.size() << ' ' << speakers.size() << '\n';
+
+    write_stats(out, "*", global);
+
+    for(auto& speaker : speakers){
+        write_stats(out, speaker.first, speaker.second);
+    }
+
+    return static_cast<bool>(out);
+}
+
+bool ana::stats_table::load(const std::string& file){
+    std::ifstream in(file);
+
+    std::string magic;
+    std::size_t version = 0;
+    std::size_t features = 0;
+    std::size_t count = 0;
+
+    if(!(in >> magic >> version >> features >> count) || magic != stats_magic || version != stats_version || features != settings().features){
+        return false;
+    }
+
+    std::string key;
+
+    if(!read_stats(in, key, global) || key != "*"){
+        return false;
+    }
+
+    speakers.clear();
+
+    for(std::size_t s = 0; s < count; ++s){
+        feature_stats stats;
+
+        if(!read_stats(in, key, stats)){
+            return false;
+        }
+
+        speakers[key] = stats;
+    }
+
+    return true;
+}
+
+std::string ana::speaker(const std::string& file){
+    auto last = file.find_last_of('/');
+
+    if(last == std::string::npos){
+        return ".";
+    }
+
+    //The whole directory, two corpora may have speaker directories of the same name
+    return file.substr(0, last);
+}
+
+ana::stats_table ana::compute_stats(const std::vector<std::string>& files, std::size_t threads){
+    std::vector<feature_stats> stats(files.size());
+
+    parallel_foreach_i(files.size(), threads, [&](std::size_t i){
+        frames_t frames;
+        read_frames(files[i], frames);
+        stats[i].add(frames);
+    });
+
+    //Merged in order, for the result not to depend on the threads
+
+    stats_table table;
+
+    for(std::size_t i = 0; i < files.size(); ++i){
+        table.global.merge(stats[i]);
+        table.speakers[speaker(files[i])].merge(stats[i]);
+    }
+
+    return table;
+}
+
+void ana::normalize_frames(const std::string& file, frames_t& frames){
+    if(normalization == normalization_mode::UTTERANCE){
+        feature_stats stats;
+        stats.add(frames);
+
+        normalization_t(stats).apply(frames);
+    } else {
+        normalization_t(file_stats(file)).apply(frames);
+    }
+}
+
+std::uint64_t ana::normalization_key(const std::string& file){
+    if(normalization == normalization_mode::UTTERANCE){
+        return 0;
+    }
+
+    normalization_t parameters(file_stats(file));
+
+    //FNV-1a of the parameters
+    std::uint64_t key = 14695981039346656037ULL;
+
+    auto hash = [&key](const std::vector<float>& values){
+        auto bytes = reinterpret_cast<const unsigned char*>(values.data());
+        for(std::size_t i = 0; i < values.size() * sizeof(float); ++i){
+            key ^= bytes[i];
+            key *= 1099511628211ULL;
+        }
+    };
+
+    hash(parameters.mean);
+    hash(parameters.scale);
+
+    return key;
+}
+
+std::uint64_t ana::stats_key(){
+    if(normalization == normalization_mode::UTTERANCE){
+        return 0;
+    }
+
+    //Make sure the statistics are valid
+    loaded_stats();
+
+    static std::uint64_t key = [](){
+        //FNV-1a of the content of the statistics file
+        std::uint64_t key = 14695981039346656037ULL;
+
+        std::ifstream in(stats_file, std::ios::binary);
+
+        char c;
+        while(in.get(c)){
+            key ^= static_cast<unsigned char>(c);
+            key *= 1099511628211ULL;
+        }
+
+        return key;
+    }();
+
+    return key;
+}
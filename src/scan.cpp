@@ -0,0 +1,142 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+
+#include <unistd.h>
+
+#include "scan.hpp"
+#include "window_arena.hpp"
+#include "parallel.hpp"
+#include "settings.hpp"
+#include "telemetry.hpp"
+
+namespace {
+
+//The estimated memory of a window read at once: the sample, its values and the allocator overhead
+std::size_t window_bytes(){
+    return sizeof(ana::sample_t) + ana::settings().window_size() * sizeof(float) + 16;
+}
+
+std::size_t total(const std::vector<std::size_t>& counts){
+    return std::accumulate(counts.begin(), counts.end(), std::size_t(0));
+}
+
+std::size_t megabytes(std::size_t bytes){
+    return bytes / (1024 * 1024);
+}
+
+} //end of anonymous namespace
+
+std::size_t ana::data_scan::pt_bytes() const {
+    return total(pt_windows) * window_bytes();
+}
+
+std::size_t ana::data_scan::ft_bytes() const {
+    return total(ft_windows) * window_bytes() + total(ft_labels) * sizeof(std::size_t);
+}
+
+std::size_t ana::count_lines(const std::string& file){
+    //The buffer is kept between calls to avoid allocations
+    thread_local std::vector<char> buffer(1024 * 1024);
+
+    auto fp = std::fopen(file.c_str(), "rb");
+
+    if(!fp){
+        return 0;
+    }
+
+    std::size_t lines = 0;
+    char last = '\n';
+
+    std::size_t read;
+    while((read = std::fread(buffer.data(), 1, buffer.size(), fp)) > 0){
+        count(counter::BYTES_READ, read);
+
+        const char* it = buffer.data();
+        const char* end = buffer.data() + read;
+
+        while((it = static_cast<const char*>(std::memchr(it, '\n', end - it)))){
+            ++lines;
+            ++it;
+        }
+
+        last = end[-1];
+    }
+
+    std::fclose(fp);
+
+    return last == '\n' ? lines : lines + 1;
+}
+
+ana::data_scan ana::scan_data(const files_t& pt_files, const paired_files_t& ft_files, std::size_t threads){
+    phase_timer timer(phase::SCAN);
+
+    data_scan scan;
+
+    scan.pt_windows.resize(pt_files.size());
+    scan.ft_windows.resize(ft_files.first.size());
+    scan.ft_labels.resize(ft_files.second.size());
+
+    //The files of the three lists are counted by the same threads
+
+    auto n = pt_files.size() + ft_files.first.size() + ft_files.second.size();
+
+    parallel_foreach_i(n, threads, [&](std::size_t i){
+        if(i < pt_files.size()){
+            scan.pt_windows[i] = count_windows(count_lines(pt_files[i]));
+        } else if((i -= pt_files.size()) < ft_files.first.size()){
+            scan.ft_windows[i] = count_windows(count_lines(ft_files.first[i]));
+        } else {
+            i -= ft_files.first.size();
+            scan.ft_labels[i] = count_windows(count_lines(ft_files.second[i]));
+        }
+    });
+
+    std::cout << "Scan: " << total(scan.pt_windows) << " pretraining windows (" << megabytes(scan.pt_bytes()) << "MB), "
+        << total(scan.ft_windows) << " fine-tuning windows (" << megabytes(scan.ft_bytes()) << "MB)" << std::endl;
+
+    return scan;
+}
+
+std::size_t ana::available_memory(){
+    std::ifstream meminfo("/proc/meminfo");
+
+    std::string line;
+    while(std::getline(meminfo, line)){
+        if(line.compare(0, 13, "MemAvailable:") == 0){
+            return std::stoul(line.substr(13)) * 1024;
+        }
+    }
+
+    return std::size_t(sysconf(_SC_AVPHYS_PAGES)) * sysconf(_SC_PAGE_SIZE);
+}
+
+void ana::choose_loading(const data_scan& scan){
+    const auto total_budget = eager_memory_bytes ? eager_memory_bytes : available_memory() / 10 * 8;
+
+    auto budget = total_budget;
+
+    //The pretraining is read at once first, its files are read at each epoch of each layer
+
+    auto& s = settings();
+
+    s.lazy_pt = scan.pt_bytes() > budget;
+
+    if(!s.lazy_pt){
+        budget -= scan.pt_bytes();
+    }
+
+    s.lazy_ft = scan.ft_bytes() > budget;
+
+    std::cout << "Loading for a budget of " << megabytes(total_budget) << "MB: "
+        << (s.lazy_pt ? "lazy" : "eager") << " pretraining, " << (s.lazy_ft ? "lazy" : "eager") << " fine-tuning" << std::endl;
+}
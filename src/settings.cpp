@@ -0,0 +1,132 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <iostream>
+#include <fstream>
+
+#include "settings.hpp"
+
+namespace {
+
+std::string trim(const std::string& value){
+    auto first = value.find_first_not_of(" \t\r");
+
+    if(first == std::string::npos){
+        return "";
+    }
+
+    auto last = value.find_last_not_of(" \t\r");
+
+    return value.substr(first, last - first + 1);
+}
+
+bool parse_size(const std::string& value, std::size_t& target){
+    try {
+        std::size_t end = 0;
+        auto result = std::stoul(value, &end);
+
+        if(end != value.size()){
+            return false;
+        }
+
+        target = result;
+        return true;
+    } catch (const std::exception&){
+        return false;
+    }
+}
+
+bool parse_bool(const std::string& value, bool& target){
+    if(value == "true" || value == "1"){
+        target = true;
+    } else if(value == "false" || value == "0"){
+        target = false;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+} //end of anonymous namespace
+
+ana::settings_t& ana::settings(){
+    static settings_t settings;
+    return settings;
+}
+
+bool ana::settings_t::set(const std::string& setting){
+    auto equal = setting.find('=');
+
+    if(equal == std::string::npos){
+        return false;
+    }
+
+    auto key = trim(setting.substr(0, equal));
+    auto value = trim(setting.substr(equal + 1));
+
+    if(key == "n"){
+        return parse_size(value, n) && n > 0;
+    } else if(key == "features"){
+        return parse_size(value, features) && features > 0;
+    } else if(key == "stride"){
+        return parse_size(value, stride) && stride > 0;
+    } else if(key == "lazy_pt"){
+        return parse_bool(value, lazy_pt);
+    } else if(key == "lazy_ft"){
+        return parse_bool(value, lazy_ft);
+    } else if(key == "jobs"){
+        return parse_size(value, jobs);
+    }
+
+    return false;
+}
+
+bool ana::settings_t::load(const std::string& file){
+    std::ifstream in(file);
+
+    if(!in){
+        std::cout << "Impossible to read the settings file \"" << file << "\"" << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while(std::getline(in, line)){
+        line = trim(line.substr(0, line.find('#')));
+
+        if(!line.empty() && !set(line)){
+            std::cout << "Invalid setting in " << file << " :" << line << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ana::settings_t::parse(int argc, char* argv[], int first){
+    for(int i = first; i < argc; ++i){
+        std::string option(argv[i]);
+
+        if(option.compare(0, 2, "--") != 0){
+            std::cout << "Invalid option :" << option << std::endl;
+            return false;
+        }
+
+        option = option.substr(2);
+
+        if(option.compare(0, 7, "config=") == 0){
+            if(!load(option.substr(7))){
+                return false;
+            }
+        } else if(!set(option)){
+            std::cout << "Invalid option :" << argv[i] << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
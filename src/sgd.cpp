@@ -0,0 +1,300 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <algorithm>
+
+#include "sgd.hpp"
+#include "batch.hpp"
+#include "blas.hpp"
+
+namespace {
+
+//Multiply the deltas by the derivative of the activation function, from the activations
+void derivative(dll::unit_type unit, const float* activations, float* deltas, std::size_t n){
+    if(unit == dll::unit_type::BINARY){
+        for(std::size_t i = 0; i < n; ++i){
+            deltas[i] *= activations[i] * (1.0f - activations[i]);
+        }
+    } else if(unit == dll::unit_type::RELU){
+        for(std::size_t i = 0; i < n; ++i){
+            if(activations[i] <= 0.0f){
+                deltas[i] = 0.0f;
+            }
+        }
+    }
+}
+
+} //end of anonymous namespace
+
+ana::sgd_trainer::sgd_trainer(std::vector<sgd_layer> layers, std::size_t threads) : layers(std::move(layers)), pool(threads) {
+    workers.resize(pool.size());
+
+    for(auto& worker : workers){
+        worker.activations.resize(this->layers.size());
+        worker.deltas.resize(this->layers.size());
+
+        for(auto& layer : this->layers){
+            worker.w_grads.emplace_back(layer.visible * layer.hidden);
+            worker.b_grads.emplace_back(layer.hidden);
+        }
+    }
+
+    for(auto& layer : this->layers){
+        w_incs.emplace_back(layer.visible * layer.hidden);
+        b_incs.emplace_back(layer.hidden);
+    }
+}
+
+std::size_t ana::sgd_trainer::gradients(worker_t& worker, const float* inputs, const std::size_t* labels, std::size_t rows){
+    //1. Forward pass
+
+    auto input = inputs;
+
+    for(std::size_t l = 0; l < layers.size(); ++l){
+        auto& layer = layers[l];
+        auto& output = worker.activations[l];
+
+        output.resize(rows * layer.hidden);
+
+        for(std::size_t r = 0; r < rows; ++r){
+            std::copy(layer.b, layer.b + layer.hidden, output.begin() + r * layer.hidden);
+        }
+
+        gemm(false, false, rows, layer.hidden, layer.visible, 1.0f, input, layer.visible, layer.w, layer.hidden, 1.0f, output.data(), layer.hidden);
+
+        detail::activate(layer.unit, output.data(), rows, layer.hidden);
+
+        input = output.data();
+    }
+
+    //2. Errors of the output layer
+
+    auto& top = layers.back();
+    auto& output = worker.activations.back();
+    auto& deltas = worker.deltas.back();
+
+    deltas.resize(rows * top.hidden);
+
+    std::size_t errors = 0;
+
+    for(std::size_t r = 0; r < rows; ++r){
+        auto first = output.begin() + r * top.hidden;
+
+        if(std::size_t(std::max_element(first, first + top.hidden) - first) != labels[r]){
+            ++errors;
+        }
+
+        for(std::size_t h = 0; h < top.hidden; ++h){
+            deltas[r * top.hidden + h] = (h == labels[r] ? 1.0f : 0.0f) - first[h];
+        }
+    }
+
+    //With softmax units, the error of the cross-entropy is directly label - output
+    if(top.unit != dll::unit_type::SOFTMAX){
+        derivative(top.unit, output.data(), deltas.data(), deltas.size());
+    }
+
+    //3. Backward pass
+
+    for(std::size_t l = layers.size(); l-- > 0;){
+        auto& layer = layers[l];
+        auto& delta = worker.deltas[l];
+
+        auto previous = l ? worker.activations[l - 1].data() : inputs;
+
+        //w_grad = input^T * delta
+
+        gemm(true, false, layer.visible, layer.hidden, rows, 1.0f, previous, layer.visible, delta.data(), layer.hidden, 0.0f, worker.w_grads[l].data(), layer.hidden);
+
+        auto& b_grad = worker.b_grads[l];
+        std::fill(b_grad.begin(), b_grad.end(), 0.0f);
+
+        for(std::size_t r = 0; r < rows; ++r){
+            for(std::size_t h = 0; h < layer.hidden; ++h){
+                b_grad[h] += delta[r * layer.hidden + h];
+            }
+        }
+
+        //delta[l - 1] = delta * w^T, times the derivative of the layer l - 1
+
+        if(l){
+            auto& previous_delta = worker.deltas[l - 1];
+            previous_delta.resize(rows * layer.visible);
+
+            gemm(false, true, rows, layer.visible, layer.hidden, 1.0f, delta.data(), layer.hidden, layer.w, layer.hidden, 0.0f, previous_delta.data(), layer.visible);
+
+            derivative(layers[l - 1].unit, worker.activations[l - 1].data(), previous_delta.data(), previous_delta.size());
+        }
+    }
+
+    return errors;
+}
+
+std::size_t ana::sgd_trainer::step(const sgd_batch& batch, const sgd_parameters& parameters){
+    auto rows = batch.labels.size();
+    auto slices = std::min(threads(), rows);
+    auto input_size = layers.front().visible;
+
+    //1. Each thread computes the gradients of its slice of the batch
+
+    pool.run([&](std::size_t t){
+        if(t < slices){
+            auto first = t * rows / slices;
+            auto last = (t + 1) * rows / slices;
+
+            workers[t].errors = gradients(workers[t], batch.inputs.data() + first * input_size, batch.labels.data() + first, last - first);
+        }
+    });
+
+    //2. Each thread reduces and updates a part of the weights
+
+    pool.run([&](std::size_t t){
+        auto part = [&](std::size_t n, std::vector<std::vector<float>> worker_t::* grads, std::vector<float>& inc, float* value, std::size_t l, bool decay){
+            auto first = t * n / threads();
+            auto last = (t + 1) * n / threads();
+
+            auto grad = (workers[0].*grads)[l].data();
+
+            for(std::size_t s = 1; s < slices; ++s){
+                auto other = (workers[s].*grads)[l].data();
+
+                for(std::size_t i = first; i < last; ++i){
+                    grad[i] += other[i];
+                }
+            }
+
+            momentum_update(first, last, grad, inc.data(), value, decay ? parameters.weight_cost : 0.0f, rows, parameters.learning_rate, parameters.momentum);
+        };
+
+        for(std::size_t l = 0; l < layers.size(); ++l){
+            part(layers[l].visible * layers[l].hidden, &worker_t::w_grads, w_incs[l], layers[l].w, l, true);
+            part(layers[l].hidden, &worker_t::b_grads, b_incs[l], layers[l].b, l, false);
+        }
+    });
+
+    std::size_t errors = 0;
+
+    for(std::size_t s = 0; s < slices; ++s){
+        errors += workers[s].errors;
+    }
+
+    return errors;
+}
+
+std::size_t ana::sgd_trainer::epoch(bounded_queue<sgd_batch>& batches, const sgd_parameters& parameters, bool hogwild){
+    std::size_t errors = 0;
+
+    if(!hogwild){
+        sgd_batch batch;
+
+        while(batches.pop(batch)){
+            errors += step(batch, parameters);
+        }
+
+        ++trained_epochs;
+
+        return errors;
+    }
+
+    pool.run([&](std::size_t t){
+        auto& worker = workers[t];
+
+        if(worker.w_incs.empty()){
+            for(auto& layer : layers){
+                worker.w_incs.emplace_back(layer.visible * layer.hidden);
+                worker.b_incs.emplace_back(layer.hidden);
+            }
+        }
+
+        worker.errors = 0;
+
+        sgd_batch batch;
+
+        while(batches.pop(batch)){
+            auto rows = batch.labels.size();
+
+            worker.errors += gradients(worker, batch.inputs.data(), batch.labels.data(), rows);
+
+            //The shared weights are updated without synchronization, the
+            //updates of the other threads can be partially overwritten
+
+            for(std::size_t l = 0; l < layers.size(); ++l){
+                momentum_update(0, layers[l].visible * layers[l].hidden, worker.w_grads[l].data(), worker.w_incs[l].data(), layers[l].w, parameters.weight_cost, rows, parameters.learning_rate, parameters.momentum);
+                momentum_update(0, layers[l].hidden, worker.b_grads[l].data(), worker.b_incs[l].data(), layers[l].b, 0.0f, rows, parameters.learning_rate, parameters.momentum);
+            }
+        }
+    });
+
+    for(auto& worker : workers){
+        errors += worker.errors;
+    }
+
+    ++trained_epochs;
+
+    return errors;
+}
+
+ana::trainer_state ana::sgd_trainer::state() const {
+    trainer_state state;
+    state.epochs = trained_epochs;
+
+    for(std::size_t l = 0; l < layers.size(); ++l){
+        state.increments.push_back(w_incs[l]);
+        state.increments.push_back(b_incs[l]);
+    }
+
+    for(auto& worker : workers){
+        for(std::size_t l = 0; l < worker.w_incs.size(); ++l){
+            state.increments.push_back(worker.w_incs[l]);
+            state.increments.push_back(worker.b_incs[l]);
+        }
+    }
+
+    return state;
+}
+
+bool ana::sgd_trainer::restore(const trainer_state& state){
+    auto& increments = state.increments;
+
+    //Either only the shared increments or also the ones of each thread (hogwild)
+    auto shared = 2 * layers.size();
+
+    if(increments.size() != shared && increments.size() != shared * (1 + workers.size())){
+        return false;
+    }
+
+    for(std::size_t i = 0; i < increments.size(); ++i){
+        auto& layer = layers[(i % shared) / 2];
+
+        if(increments[i].size() != (i % 2 ? layer.hidden : layer.visible * layer.hidden)){
+            return false;
+        }
+    }
+
+    for(std::size_t l = 0; l < layers.size(); ++l){
+        w_incs[l] = increments[2 * l];
+        b_incs[l] = increments[2 * l + 1];
+    }
+
+    for(std::size_t t = 0; t < workers.size(); ++t){
+        auto& worker = workers[t];
+
+        worker.w_incs.clear();
+        worker.b_incs.clear();
+
+        if(increments.size() > shared){
+            for(std::size_t l = 0; l < layers.size(); ++l){
+                worker.w_incs.push_back(increments[shared * (1 + t) + 2 * l]);
+                worker.b_incs.push_back(increments[shared * (1 + t) + 2 * l + 1]);
+            }
+        }
+    }
+
+    trained_epochs = state.epochs;
+
+    return true;
+}
@@ -0,0 +1,226 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "shard.hpp"
+#include "frames.hpp"
+#include "normalization.hpp"
+#include "settings.hpp"
+
+namespace {
+
+constexpr const char magic[8] = {'A', 'N', 'A', 'S', 'H', 'A', 'R', 'D'};
+
+//Must be incremented each time the layout of the shards changes
+constexpr const std::uint32_t version = 3;
+
+constexpr const std::size_t alignment = 64;
+
+//FNV-1a of the names of the files, the labels of each window being taken from the listing
+std::uint64_t files_hash(const ana::files_t& samples_files, const ana::files_t& labels_files){
+    std::uint64_t key = 14695981039346656037ULL;
+
+    auto hash = [&key](const ana::files_t& files){
+        for(auto& file : files){
+            for(auto c : file){
+                key ^= static_cast<unsigned char>(c);
+                key *= 1099511628211ULL;
+            }
+
+            key ^= '\n';
+            key *= 1099511628211ULL;
+        }
+
+        key ^= files.size();
+        key *= 1099511628211ULL;
+    };
+
+    hash(samples_files);
+    hash(labels_files);
+
+    return key;
+}
+
+} //end of anonymous namespace
+
+bool ana::write_shard(const paired_files_t& files, const files_t& samples_files, bool pt, const std::string& shard_file){
+    //Write to a temporary file first so that an interrupted write never leaves a partial shard
+    auto temp = shard_file + ".tmp" + std::to_string(getpid());
+
+    auto fp = std::fopen(temp.c_str(), "wb");
+
+    if(!fp){
+        std::cout << "Impossible to create the shard \"" << temp << "\"" << std::endl;
+        return false;
+    }
+
+    shard_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+
+    header.version       = version;
+    auto& shape = settings();
+
+    header.n             = shape.n;
+    header.stride        = shape.stride;
+    header.features      = shape.features;
+    header.frames_offset = ((sizeof(header) + alignment - 1) / alignment) * alignment;
+    header.files_hash    = files_hash(samples_files, pt ? files_t() : files.second);
+    header.normalization = static_cast<std::uint64_t>(normalization);
+    header.stats_hash    = stats_key();
+
+    //The header is written again once the tables are known
+    std::fseek(fp, header.frames_offset, SEEK_SET);
+
+    std::vector<shard_utterance> utterances;
+    std::vector<std::uint64_t> windows;
+
+    bool valid = true;
+
+    frames_t frames;
+    std::vector<std::string> labels;
+
+    for(std::size_t f = 0; f < samples_files.size() && valid; ++f){
+        read_frames(samples_files[f], frames);
+        normalize_frames(samples_files[f], frames);
+
+        shard_utterance utterance;
+        utterance.first_frame  = header.frames;
+        utterance.frames       = frames.rows;
+        utterance.first_window = windows.size();
+
+        if(!pt && drop_sil_windows){
+            labels.clear();
+            read_labels_str(files.second[f], labels);
+
+            auto count = frames.rows > shape.n ? (frames.rows - shape.n - 1) / shape.stride + 1 : 0;
+
+            if(labels.size() != count){
+                std::cout << "Inconsistency between labels and samples windows" << std::endl;
+                std::cout << "features file: " << files.first[f] << std::endl;
+                std::cout << "label file: " << files.second[f] << std::endl;
+                std::abort();
+            }
+        }
+
+        std::size_t w = 0;
+        for(std::size_t i = 0; i + shape.n < frames.rows; i += shape.stride, ++w){
+            if(!pt && drop_sil_windows && labels[w] == "sil"){
+                continue;
+            }
+
+            windows.push_back(header.frames + i);
+        }
+
+        utterance.windows = windows.size() - utterance.first_window;
+        utterances.push_back(utterance);
+
+        valid = std::fwrite(frames.values.data(), sizeof(float), frames.rows * shape.features, fp) == frames.rows * shape.features;
+
+        header.frames += frames.rows;
+
+        std::cout << '.';
+        std::cout.flush();
+    }
+
+    std::cout << std::endl;
+
+    header.utterances        = utterances.size();
+    header.windows           = windows.size();
+    header.utterances_offset = header.frames_offset + header.frames * shape.features * sizeof(float);
+    header.windows_offset    = header.utterances_offset + header.utterances * sizeof(shard_utterance);
+
+    valid = valid
+        &&  std::fwrite(utterances.data(), sizeof(shard_utterance), utterances.size(), fp) == utterances.size()
+        &&  std::fwrite(windows.data(), sizeof(std::uint64_t), windows.size(), fp) == windows.size()
+        &&  std::fseek(fp, 0, SEEK_SET) == 0
+        &&  std::fwrite(&header, sizeof(header), 1, fp) == 1;
+
+    valid = std::fclose(fp) == 0 && valid;
+
+    if(!valid || std::rename(temp.c_str(), shard_file.c_str()) != 0){
+        std::cout << "Impossible to write the shard \"" << shard_file << "\"" << std::endl;
+        std::remove(temp.c_str());
+        return false;
+    }
+
+    std::cout << "Shard \"" << shard_file << "\": " << header.utterances << " utterances, "
+        << header.frames << " frames, " << header.windows << " windows" << std::endl;
+
+    return true;
+}
+
+ana::shard_t::shard_t(const std::string& shard_file, const files_t& samples_files, const files_t& labels_files){
+    auto fd = open(shard_file.c_str(), O_RDONLY);
+
+    if(fd < 0){
+        std::cout << "Impossible to open the shard \"" << shard_file << "\"" << std::endl;
+        return;
+    }
+
+    struct stat buffer;
+    if(fstat(fd, &buffer) != 0 || static_cast<std::size_t>(buffer.st_size) < sizeof(shard_header)){
+        std::cout << "Invalid shard \"" << shard_file << "\"" << std::endl;
+        close(fd);
+        return;
+    }
+
+    mapping_size = buffer.st_size;
+    mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    //The mapping stays valid after the descriptor is closed
+    close(fd);
+
+    if(mapping == MAP_FAILED){
+        std::cout << "Impossible to map the shard \"" << shard_file << "\"" << std::endl;
+        mapping = nullptr;
+        return;
+    }
+
+    //The windows are traversed in order, the kernel can read ahead
+    madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+
+    auto base = static_cast<const char*>(mapping);
+    auto h = reinterpret_cast<const shard_header*>(base);
+
+    if(std::memcmp(h->magic, magic, sizeof(magic)) != 0 || h->version != version
+            || h->n != settings().n || h->stride != settings().stride || h->features != settings().features
+            || h->windows_offset + h->windows * sizeof(std::uint64_t) > mapping_size){
+        std::cout << "The shard \"" << shard_file << "\" is invalid or was built with another configuration" << std::endl;
+        return;
+    }
+
+    if(h->files_hash != files_hash(samples_files, labels_files) || h->utterances != samples_files.size()){
+        std::cout << "The shard \"" << shard_file << "\" was built from other files, it must be built again" << std::endl;
+        return;
+    }
+
+    if(h->normalization != static_cast<std::uint64_t>(normalization) || h->stats_hash != stats_key()){
+        std::cout << "The shard \"" << shard_file << "\" was normalized with another mode or other statistics, it must be built again" << std::endl;
+        return;
+    }
+
+    header           = h;
+    frames           = reinterpret_cast<const float*>(base + h->frames_offset);
+    utterances_table = reinterpret_cast<const shard_utterance*>(base + h->utterances_offset);
+    windows_table    = reinterpret_cast<const std::uint64_t*>(base + h->windows_offset);
+}
+
+ana::shard_t::~shard_t(){
+    if(mapping){
+        munmap(mapping, mapping_size);
+    }
+}
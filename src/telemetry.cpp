@@ -0,0 +1,143 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+
+#include "telemetry.hpp"
+
+namespace {
+
+const char* counter_names[] = {
+    "bytes_read",
+    "files",
+    "frames",
+    "windows",
+    "file_switches",
+    "bytes_written",
+    "allocations",
+    "allocated_bytes",
+    "cache_hits",
+    "cache_misses",
+    "cache_evictions"
+};
+
+const char* phase_names[] = {
+    "get_files",
+    "scan",
+    "parse",
+    "normalize",
+    "windows",
+    "file_switch",
+    "pretraining",
+    "fine_tuning",
+    "features",
+    "write_features",
+    "test"
+};
+
+static_assert(sizeof(counter_names) / sizeof(counter_names[0]) == std::size_t(ana::counter::COUNT), "Missing counter name");
+static_assert(sizeof(phase_names) / sizeof(phase_names[0]) == std::size_t(ana::phase::COUNT), "Missing phase name");
+
+double seconds(std::uint64_t nanoseconds){
+    return nanoseconds * 1e-9;
+}
+
+} //end of anonymous namespace
+
+ana::telemetry_t::telemetry_t() : start(std::chrono::steady_clock::now()) {
+    for(auto& value : counters){
+        value = 0;
+    }
+
+    for(std::size_t i = 0; i < std::size_t(phase::COUNT); ++i){
+        nanoseconds[i] = 0;
+        calls[i] = 0;
+    }
+}
+
+ana::telemetry_t& ana::telemetry(){
+    static telemetry_t telemetry;
+    return telemetry;
+}
+
+void ana::telemetry_t::report() const {
+    auto wall = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    //The report allocates, the values are taken once so that all the outputs are the same
+
+    std::uint64_t counters[std::size_t(counter::COUNT)];
+    std::uint64_t nanoseconds[std::size_t(phase::COUNT)];
+    std::uint64_t calls[std::size_t(phase::COUNT)];
+
+    for(std::size_t i = 0; i < std::size_t(counter::COUNT); ++i){
+        counters[i] = this->counters[i];
+    }
+
+    for(std::size_t i = 0; i < std::size_t(phase::COUNT); ++i){
+        nanoseconds[i] = this->nanoseconds[i];
+        calls[i] = this->calls[i];
+    }
+
+    //1. JSON report
+
+    std::ofstream json(telemetry_file + ".json");
+
+    json << "{\n";
+    json << "  \"wall_seconds\": " << seconds(wall) << ",\n";
+
+    json << "  \"counters\": {\n";
+    for(std::size_t i = 0; i < std::size_t(counter::COUNT); ++i){
+        json << "    \"" << counter_names[i] << "\": " << counters[i] << (i + 1 < std::size_t(counter::COUNT) ? ",\n" : "\n");
+    }
+    json << "  },\n";
+
+    json << "  \"phases\": {\n";
+    for(std::size_t i = 0; i < std::size_t(phase::COUNT); ++i){
+        json << "    \"" << phase_names[i] << "\": {\"seconds\": " << seconds(nanoseconds[i]) << ", \"calls\": " << calls[i] << "}"
+             << (i + 1 < std::size_t(phase::COUNT) ? ",\n" : "\n");
+    }
+    json << "  }\n";
+    json << "}\n";
+
+    //2. CSV report, one line per value
+
+    std::ofstream csv(telemetry_file + ".csv");
+
+    csv << "kind,name,value,calls\n";
+    csv << "wall,run," << seconds(wall) << ",1\n";
+
+    for(std::size_t i = 0; i < std::size_t(counter::COUNT); ++i){
+        csv << "counter," << counter_names[i] << "," << counters[i] << ",\n";
+    }
+
+    for(std::size_t i = 0; i < std::size_t(phase::COUNT); ++i){
+        csv << "phase," << phase_names[i] << "," << seconds(nanoseconds[i]) << "," << calls[i] << "\n";
+    }
+
+    if(!json || !csv){
+        std::cout << "Impossible to write the telemetry report \"" << telemetry_file << "\"" << std::endl;
+    }
+
+    //3. Summary
+
+    std::cout << "\nTelemetry (" << std::fixed << std::setprecision(3) << seconds(wall) << "s)" << std::endl;
+
+    for(std::size_t i = 0; i < std::size_t(phase::COUNT); ++i){
+        if(calls[i]){
+            std::cout << "  " << std::left << std::setw(16) << phase_names[i] << std::right << std::setw(12) << seconds(nanoseconds[i]) << "s"
+                << std::setw(12) << calls[i] << " calls" << std::endl;
+        }
+    }
+
+    for(std::size_t i = 0; i < std::size_t(counter::COUNT); ++i){
+        std::cout << "  " << std::left << std::setw(16) << counter_names[i] << std::right << std::setw(13) << counters[i] << std::endl;
+    }
+
+    std::cout << std::defaultfloat;
+}
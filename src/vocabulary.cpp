@@ -0,0 +1,181 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <set>
+#include <cstring>
+
+#include "config.hpp"
+#include "data.hpp"
+#include "parallel.hpp"
+#include "vocabulary.hpp"
+
+namespace {
+
+constexpr const std::uint64_t fnv_offset = 14695981039346656037ULL;
+constexpr const std::uint64_t fnv_prime = 1099511628211ULL;
+
+//The table is doubled every 1000 seeds, a perfect hash is found long before
+constexpr const std::size_t max_attempts = 16000;
+
+} //end of anonymous namespace
+
+ana::label_vocabulary& ana::vocabulary(){
+    static label_vocabulary vocabulary;
+    return vocabulary;
+}
+
+void ana::label_vocabulary::build(const std::vector<std::string>& label_files, std::size_t threads){
+    if(frozen()){
+        std::cout << "The label vocabulary is frozen, it cannot be extended" << std::endl;
+        std::abort();
+    }
+
+    std::vector<std::set<std::string>> file_labels(label_files.size());
+
+    parallel_foreach_i(label_files.size(), threads, [&](std::size_t i){
+        std::vector<std::string> labels;
+        read_labels_str(label_files[i], labels);
+
+        for(auto& label : labels){
+            if(!(drop_sil_windows && label == "sil")){
+                file_labels[i].insert(label);
+            }
+        }
+    });
+
+    std::set<std::string> new_names;
+    for(auto& labels : file_labels){
+        new_names.insert(labels.begin(), labels.end());
+    }
+
+    for(auto& name : names){
+        new_names.erase(name);
+    }
+
+    names.insert(names.end(), new_names.begin(), new_names.end());
+}
+
+void ana::label_vocabulary::freeze(){
+    //Two equal labels can never be hashed to different slots
+    std::set<std::string> distinct(names.begin(), names.end());
+
+    if(distinct.size() != names.size()){
+        std::cout << "The label vocabulary contains duplicate labels" << std::endl;
+        std::abort();
+    }
+
+    std::size_t slots = 4;
+    while(slots < 4 * names.size()){
+        slots *= 2;
+    }
+
+    //Search a seed for which the hash is perfect, growing the table if needed
+
+    for(std::size_t attempt = 0; ; ++attempt){
+        if(attempt == max_attempts){
+            std::cout << "Impossible to find a perfect hash for the " << names.size() << " labels" << std::endl;
+            std::abort();
+        }
+
+        if(attempt && attempt % 1000 == 0){
+            slots *= 2;
+        }
+
+        seed = attempt;
+        mask = slots - 1;
+        table.assign(slots, 0);
+
+        bool perfect = true;
+
+        for(std::size_t i = 0; i < names.size() && perfect; ++i){
+            auto& slot = table[hash(names[i].data(), names[i].size()) & mask];
+
+            if(slot){
+                perfect = false;
+            } else {
+                slot = i + 1;
+            }
+        }
+
+        if(perfect){
+            break;
+        }
+    }
+}
+
+std::uint64_t ana::label_vocabulary::hash(const char* label, std::size_t length) const {
+    std::uint64_t h = fnv_offset ^ (seed * fnv_prime);
+
+    for(std::size_t i = 0; i < length; ++i){
+        h ^= static_cast<unsigned char>(label[i]);
+        h *= fnv_prime;
+    }
+
+    return h ^ (h >> 29);
+}
+
+std::size_t ana::label_vocabulary::id(const char* label, std::size_t length) const {
+    auto slot = table[hash(label, length) & mask];
+
+    if(!slot){
+        return npos;
+    }
+
+    auto& name = names[slot - 1];
+
+    if(name.size() != length || std::memcmp(name.data(), label, length) != 0){
+        return npos;
+    }
+
+    return slot - 1;
+}
+
+bool ana::label_vocabulary::store(const std::string& file) const {
+    std::ofstream out(file);
+    return store(out);
+}
+
+bool ana::label_vocabulary::store(std::ostream& out) const {
+    for(auto& name : names){
+        out << name << '\n';
+    }
+
+    return static_cast<bool>(out);
+}
+
+bool ana::label_vocabulary::load(const std::string& file){
+    std::ifstream in(file);
+
+    if(!in){
+        return false;
+    }
+
+    return load(in);
+}
+
+bool ana::label_vocabulary::load(std::istream& in){
+    names.clear();
+    table.clear();
+
+    std::set<std::string> distinct;
+
+    std::string line;
+    while(std::getline(in, line)){
+        if(!distinct.insert(line).second){
+            std::cout << "The label \"" << line << "\" appears twice in the stored vocabulary" << std::endl;
+            names.clear();
+            return false;
+        }
+
+        names.push_back(line);
+    }
+
+    return true;
+}
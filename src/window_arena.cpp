@@ -0,0 +1,61 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2015.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+
+#include "window_arena.hpp"
+#include "frames.hpp"
+#include "settings.hpp"
+
+void ana::window_arena::resize(std::size_t windows){
+    size = settings().window_size();
+
+    if(windows * size > capacity){
+        void* block = nullptr;
+
+        if(posix_memalign(&block, alignment, windows * size * sizeof(float)) != 0){
+            throw std::bad_alloc();
+        }
+
+        memory.reset(static_cast<float*>(block));
+        capacity = windows * size;
+    }
+
+    count = windows;
+}
+
+std::size_t ana::count_windows(std::size_t frames){
+    auto& shape = settings();
+
+    return frames > shape.n ? (frames - shape.n - 1) / shape.stride + 1 : 0;
+}
+
+void ana::assemble_windows(const frames_t& frames, window_arena& windows){
+    auto& shape = settings();
+
+    windows.resize(count_windows(frames.rows));
+
+    auto window_bytes = windows.window_size() * sizeof(float);
+
+    if(windows.empty()){
+        return;
+    }
+
+    //The N frames of a window are contiguous in the frame matrix
+
+    if(shape.stride == shape.n){
+        //The windows are the beginning of the frame matrix
+        std::memcpy(windows.data(), frames.row(0), windows.windows() * window_bytes);
+    } else {
+        for(std::size_t w = 0; w < windows.windows(); ++w){
+            std::memcpy(windows.window(w), frames.row(w * shape.stride), window_bytes);
+        }
+    }
+}